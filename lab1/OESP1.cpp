@@ -1,106 +1,440 @@
-//#include <windows.h>
-//#include <iostream>
-//#include <vector>
-//#include <string>
-//
-//struct ThreadParams {
-//    HANDLE hFile;
-//    DWORD startOffset;
-//    DWORD bytesToRead;
-//    std::vector<char>* buffer;
-//};
-//
-//
-//DWORD WINAPI ReadFileChunk(LPVOID lpParam) {
-//    ThreadParams* params = static_cast<ThreadParams*>(lpParam);
-//
-//    SetFilePointer(params->hFile, params->startOffset, NULL, FILE_BEGIN);
-//
-//    DWORD bytesRead;
-//    params->buffer->resize(params->bytesToRead);
-//    ReadFile(params->hFile, params->buffer->data(), params->bytesToRead, &bytesRead, NULL);
-//
-//    return 0;
-//}
-//
-//bool fileExists(const std::string& fileName) {
-//
-//    std::wstring wideFileName(fileName.begin(), fileName.end());
-//    DWORD fileAttributes = GetFileAttributes(wideFileName.c_str());
-//
-//    if (fileAttributes == INVALID_FILE_ATTRIBUTES) {
-//
-//        return false;
-//    }
-//    return true;
-//}
-//
-//void read_file_multithread(std::string fileName, int numThreads)
-//{
-//    HANDLE hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-//    if (hFile == INVALID_HANDLE_VALUE) {
-//        std::cerr << "Error opening file.\n";
-//        return;
-//    }
-//
-//    LARGE_INTEGER fileSize;
-//    GetFileSizeEx(hFile, &fileSize);
-//
-//    DWORD chunkSize = static_cast<DWORD>(fileSize.QuadPart / numThreads);
-//    DWORD lastChunkSize = chunkSize + static_cast<DWORD>(fileSize.QuadPart % numThreads);
-//
-//    std::vector<HANDLE> threadHandles(numThreads);
-//    std::vector<std::vector<char>> buffers(numThreads);
-//
-//    LARGE_INTEGER frequency, start, end;
-//    QueryPerformanceFrequency(&frequency);
-//    QueryPerformanceCounter(&start);
-//
-//    for (int i = 0; i < numThreads; ++i) {
-//        DWORD currentChunkSize = (i == numThreads - 1) ? lastChunkSize : chunkSize;
-//        ThreadParams* params = new ThreadParams{ hFile, i * chunkSize, currentChunkSize, &buffers[i] };
-//
-//        threadHandles[i] = CreateThread(NULL, 0, ReadFileChunk, params, 0, NULL);
-//        if (threadHandles[i] == NULL) {
-//            std::cerr << "Error while creating thread.\n";
-//            return;
-//        }
-//    }
-//
-//    WaitForMultipleObjects(numThreads, threadHandles.data(), TRUE, INFINITE);
-//
-//    for (HANDLE threadHandle : threadHandles) {
-//        CloseHandle(threadHandle);
-//    }
-//    CloseHandle(hFile);
-//
-//    QueryPerformanceCounter(&end);
-//    double elapsedTime = static_cast<double>(end.QuadPart - start.QuadPart) / frequency.QuadPart;
-//
-//    std::vector<char> finalData;
-//    for (const auto& buffer : buffers) {
-//        finalData.insert(finalData.end(), buffer.begin(), buffer.end());
-//    }
-//
-//    //std::string output(finalData.begin(), finalData.end());
-//    //std::cout << output << std::endl;
-//
-//    std::cout << "File reading time: " << elapsedTime << " seconds\n";
-//    std::cout << "Reading file size: " << finalData.size() << " bytes\n";
-//}
-//
-//int main() {
-//    std::string fileName;
-//    int numThreads;
-//
-//    while (true)
-//    {
-//        std::cout << "Enter file name to read: ";
-//        std::cin >> fileName;
-//        std::cout << "Enter thread count: ";
-//        std::cin >> numThreads;
-//        read_file_multithread(fileName, numThreads);
-//    }
-// 
-//    return 0;
-//}
+#include <windows.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+enum ReadBackend {
+    BACKEND_BUFFERED,   // Reads go through the system file cache
+    BACKEND_DIRECT      // FILE_FLAG_NO_BUFFERING, sector-aligned requests
+};
+
+struct ReadConfig {
+    int numThreads;
+    DWORD requestSize;
+};
+
+struct ThreadParams {
+    const std::string* fileName;
+    DWORD flags;
+    ULONGLONG startOffset;
+    ULONGLONG bytesToRead;
+    DWORD requestSize;
+    ULONGLONG bytesRead;
+    bool failed;
+};
+
+const DWORD DEFAULT_REQUEST_SIZE = 1024 * 1024;
+const DWORD DIRECT_ALIGNMENT = 4096;
+const double MEGABYTE = 1024.0 * 1024.0;
+
+
+DWORD WINAPI ReadFileChunk(LPVOID lpParam) {
+    ThreadParams* params = static_cast<ThreadParams*>(lpParam);
+
+    // Every thread opens its own handle: Windows serializes synchronous
+    // I/O on a shared handle, so one handle would never read in parallel
+    HANDLE hFile = CreateFileA(params->fileName->c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, params->flags, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        params->failed = true;
+        return 1;
+    }
+
+    // Page-aligned buffer also satisfies the FILE_FLAG_NO_BUFFERING alignment rules
+    char* buffer = static_cast<char*>(VirtualAlloc(NULL, params->requestSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+    if (buffer == NULL) {
+        params->failed = true;
+        CloseHandle(hFile);
+        return 1;
+    }
+
+    ULONGLONG offset = params->startOffset;
+    ULONGLONG end = params->startOffset + params->bytesToRead;
+    while (offset < end) {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        DWORD bytesRead = 0;
+        if (!ReadFile(hFile, buffer, params->requestSize, &bytesRead, &overlapped)) {
+            params->failed = GetLastError() != ERROR_HANDLE_EOF;
+            break;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        params->bytesRead += std::min<ULONGLONG>(bytesRead, end - offset);
+        offset += bytesRead;
+    }
+
+    VirtualFree(buffer, 0, MEM_RELEASE);
+    CloseHandle(hFile);
+    return params->failed ? 1 : 0;
+}
+
+bool fileExists(const std::string& fileName) {
+
+    std::wstring wideFileName(fileName.begin(), fileName.end());
+    DWORD fileAttributes = GetFileAttributes(wideFileName.c_str());
+
+    if (fileAttributes == INVALID_FILE_ATTRIBUTES) {
+
+        return false;
+    }
+    return true;
+}
+
+const char* backend_name(ReadBackend backend) {
+    return backend == BACKEND_DIRECT ? "direct" : "buffered";
+}
+
+bool parse_backend(const std::string& name, ReadBackend& backend) {
+    if (name == "buffered") {
+        backend = BACKEND_BUFFERED;
+    }
+    else if (name == "direct") {
+        backend = BACKEND_DIRECT;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+ReadConfig default_config() {
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return ReadConfig{ static_cast<int>(systemInfo.dwNumberOfProcessors), DEFAULT_REQUEST_SIZE };
+}
+
+// Returns throughput in MB/s, or a negative value on error. The number of
+// threads actually started goes to threadsUsed: it is smaller than
+// config.numThreads when the file has fewer requests than threads.
+double read_file_multithread(const std::string& fileName, const ReadConfig& config, ReadBackend backend, bool verbose,
+    int* threadsUsed = NULL)
+{
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (backend == BACKEND_DIRECT) {
+        flags |= FILE_FLAG_NO_BUFFERING;
+    }
+    HANDLE hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error opening file.\n";
+        return -1;
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(hFile, &fileSize);
+    CloseHandle(hFile);
+
+    int numThreads = std::max(1, std::min(config.numThreads, MAXIMUM_WAIT_OBJECTS));
+    DWORD requestSize = std::max<DWORD>(config.requestSize, 1);
+    if (backend == BACKEND_DIRECT) {
+        requestSize = (requestSize + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+    }
+
+    // Chunks are whole numbers of requests, so every read except the one
+    // at the end of the file stays aligned and inside its chunk. Threads
+    // that would be left without a request are not started
+    ULONGLONG totalSize = static_cast<ULONGLONG>(fileSize.QuadPart);
+    ULONGLONG requests = (totalSize + requestSize - 1) / requestSize;
+    ULONGLONG chunkRequests = std::max<ULONGLONG>(1, (requests + numThreads - 1) / numThreads);
+    numThreads = static_cast<int>(std::max<ULONGLONG>(1, (requests + chunkRequests - 1) / chunkRequests));
+    ULONGLONG chunkSize = chunkRequests * requestSize;
+
+    std::vector<HANDLE> threadHandles;
+    std::vector<ThreadParams> params(numThreads);
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    bool failed = false;
+    for (int i = 0; i < numThreads; ++i) {
+        ULONGLONG startOffset = i * chunkSize;
+        if (startOffset >= totalSize) {
+            break;
+        }
+        params[i] = ThreadParams{ &fileName, flags, startOffset, std::min(chunkSize, totalSize - startOffset), requestSize, 0, false };
+
+        HANDLE threadHandle = CreateThread(NULL, 0, ReadFileChunk, &params[i], 0, NULL);
+        if (threadHandle == NULL) {
+            std::cerr << "Error while creating thread.\n";
+            failed = true;
+            break;
+        }
+        threadHandles.push_back(threadHandle);
+    }
+
+    if (!threadHandles.empty()) {
+        WaitForMultipleObjects(static_cast<DWORD>(threadHandles.size()), threadHandles.data(), TRUE, INFINITE);
+    }
+
+    QueryPerformanceCounter(&end);
+
+    for (HANDLE threadHandle : threadHandles) {
+        CloseHandle(threadHandle);
+    }
+    if (threadsUsed) {
+        *threadsUsed = static_cast<int>(threadHandles.size());
+    }
+    for (const auto& param : params) {
+        failed = failed || param.failed;
+    }
+
+    if (failed) {
+        std::cerr << "Error reading file.\n";
+        return -1;
+    }
+
+    double elapsedTime = static_cast<double>(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+
+    ULONGLONG bytesRead = 0;
+    for (const auto& param : params) {
+        bytesRead += param.bytesRead;
+    }
+    double throughput = elapsedTime > 0 ? bytesRead / MEGABYTE / elapsedTime : 0;
+
+    if (verbose) {
+        std::cout << "Threads: " << threadHandles.size();
+        if (static_cast<int>(threadHandles.size()) < config.numThreads) {
+            std::cout << " of " << config.numThreads << " requested";
+        }
+        std::cout << ", request size: " << requestSize / 1024
+            << " KB, backend: " << backend_name(backend) << "\n";
+        std::cout << "File reading time: " << elapsedTime << " seconds\n";
+        std::cout << "Reading file size: " << bytesRead << " bytes\n";
+        std::cout << "Throughput: " << std::fixed << std::setprecision(1) << throughput << " MB/s\n";
+        std::cout.unsetf(std::ios::fixed);
+    }
+    return throughput;
+}
+
+// Opening the file without buffering flushes its pages out of the system
+// cache (as long as no other cached handle is open), so the next timed run
+// reads from the device
+void drop_file_cache(const std::string& fileName) {
+    HANDLE hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(hFile);
+    }
+}
+
+// Tuned settings are kept in OESP1.ini next to the executable, one section
+// per volume (serial number and file system) and backend
+std::string get_config_path() {
+    char modulePath[MAX_PATH];
+    GetModuleFileNameA(NULL, modulePath, MAX_PATH);
+    std::string path(modulePath);
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("\\/");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+        path.erase(dot);
+    }
+    return path + ".ini";
+}
+
+bool get_device_section(const std::string& fileName, ReadBackend backend, std::string& section, std::string& volume) {
+    char fullPath[MAX_PATH];
+    char volumePath[MAX_PATH];
+    char fileSystem[MAX_PATH];
+    DWORD serialNumber = 0;
+
+    if (!GetFullPathNameA(fileName.c_str(), MAX_PATH, fullPath, NULL) ||
+        !GetVolumePathNameA(fullPath, volumePath, MAX_PATH) ||
+        !GetVolumeInformationA(volumePath, NULL, 0, &serialNumber, NULL, NULL, fileSystem, MAX_PATH)) {
+        return false;
+    }
+
+    char name[MAX_PATH + 32];
+    sprintf_s(name, sizeof(name), "%08lX-%s-%s", serialNumber, fileSystem, backend_name(backend));
+    section = name;
+    volume = volumePath;
+    return true;
+}
+
+bool load_tuned_config(const std::string& fileName, ReadBackend backend, ReadConfig& config) {
+    std::string section, volume;
+    if (!get_device_section(fileName, backend, section, volume)) {
+        return false;
+    }
+    std::string path = get_config_path();
+    int numThreads = GetPrivateProfileIntA(section.c_str(), "threads", 0, path.c_str());
+    DWORD requestSize = GetPrivateProfileIntA(section.c_str(), "requestSize", 0, path.c_str());
+    if (numThreads <= 0 || requestSize == 0) {
+        return false;
+    }
+    config.numThreads = numThreads;
+    config.requestSize = requestSize;
+    return true;
+}
+
+void save_tuned_config(const std::string& fileName, ReadBackend backend, const ReadConfig& config, double throughput) {
+    std::string section, volume;
+    if (!get_device_section(fileName, backend, section, volume)) {
+        std::cerr << "Cannot identify the volume, configuration not saved.\n";
+        return;
+    }
+    std::string path = get_config_path();
+    char text[64];
+
+    WritePrivateProfileStringA(section.c_str(), "volume", volume.c_str(), path.c_str());
+    sprintf_s(text, sizeof(text), "%d", config.numThreads);
+    WritePrivateProfileStringA(section.c_str(), "threads", text, path.c_str());
+    sprintf_s(text, sizeof(text), "%lu", config.requestSize);
+    WritePrivateProfileStringA(section.c_str(), "requestSize", text, path.c_str());
+    sprintf_s(text, sizeof(text), "%.1f", throughput);
+    WritePrivateProfileStringA(section.c_str(), "throughput", text, path.c_str());
+
+    std::cout << "Saved to " << path << " [" << section << "]\n";
+}
+
+// Sweeps thread counts and request sizes. Every cell is the median of
+// `repeats` cold runs, with the file dropped from the cache before each run.
+void autotune(const std::string& fileName, ReadBackend backend, int repeats)
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    int maxThreads = std::min(static_cast<int>(systemInfo.dwNumberOfProcessors) * 2, static_cast<int>(MAXIMUM_WAIT_OBJECTS));
+
+    std::vector<int> threadCounts;
+    for (int n = 1; n <= maxThreads; n *= 2) {
+        threadCounts.push_back(n);
+    }
+    if (threadCounts.back() != maxThreads) {
+        threadCounts.push_back(maxThreads);
+    }
+    const DWORD requestSizes[] = { 64 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+    const int requestSizeCount = sizeof(requestSizes) / sizeof(requestSizes[0]);
+
+    std::cout << "Autotune: " << fileName << ", backend " << backend_name(backend)
+        << ", " << repeats << " runs per configuration\n";
+
+    // A negative cell means the file has fewer requests than threads, so
+    // that thread count was never actually run and is left out
+    std::vector<std::vector<double>> matrix(requestSizeCount, std::vector<double>(threadCounts.size(), -1));
+    ReadConfig best = default_config();
+    double bestThroughput = -1;
+
+    for (int i = 0; i < requestSizeCount; ++i) {
+        for (size_t j = 0; j < threadCounts.size(); ++j) {
+            ReadConfig config{ threadCounts[j], requestSizes[i] };
+            std::vector<double> runs;
+            for (int r = 0; r < repeats; ++r) {
+                int threadsUsed = 0;
+                drop_file_cache(fileName);
+                double throughput = read_file_multithread(fileName, config, backend, false, &threadsUsed);
+                if (throughput < 0) {
+                    return;
+                }
+                if (threadsUsed < config.numThreads) {
+                    break;
+                }
+                runs.push_back(throughput);
+            }
+            if (runs.empty()) {
+                continue;
+            }
+            std::sort(runs.begin(), runs.end());
+            matrix[i][j] = runs[runs.size() / 2];
+            if (matrix[i][j] > bestThroughput) {
+                bestThroughput = matrix[i][j];
+                best = config;
+            }
+        }
+    }
+
+    std::cout << "\nThroughput, MB/s (rows - request size, columns - threads)\n";
+    std::cout << std::setw(10) << "KB";
+    for (int threads : threadCounts) {
+        std::cout << std::setw(10) << threads;
+    }
+    std::cout << "\n" << std::fixed << std::setprecision(1);
+    for (int i = 0; i < requestSizeCount; ++i) {
+        std::cout << std::setw(10) << requestSizes[i] / 1024;
+        for (double throughput : matrix[i]) {
+            if (throughput < 0) {
+                std::cout << std::setw(10) << "-";
+            } else {
+                std::cout << std::setw(10) << throughput;
+            }
+        }
+        std::cout << "\n";
+    }
+    if (bestThroughput < 0) {
+        std::cout << "\nThe file is too small to measure, configuration not saved.\n";
+        std::cout.unsetf(std::ios::fixed);
+        return;
+    }
+    std::cout << "\nBest: " << best.numThreads << " threads, " << best.requestSize / 1024
+        << " KB requests, " << bestThroughput << " MB/s\n";
+    std::cout.unsetf(std::ios::fixed);
+
+    save_tuned_config(fileName, backend, best, bestThroughput);
+}
+
+ReadConfig tuned_or_default_config(const std::string& fileName, ReadBackend backend) {
+    ReadConfig config = default_config();
+    if (!load_tuned_config(fileName, backend, config)) {
+        std::cout << "No tuned configuration for this volume, using defaults (see --autotune).\n";
+    }
+    return config;
+}
+
+int main(int argc, char* argv[]) {
+    ReadBackend backend = BACKEND_BUFFERED;
+
+    // OESP1 --autotune <file> [buffered|direct] [repeats]
+    if (argc >= 3 && std::string(argv[1]) == "--autotune") {
+        if (argc >= 4 && !parse_backend(argv[3], backend)) {
+            std::cerr << "Unknown backend: " << argv[3] << "\n";
+            return 1;
+        }
+        int repeats = argc >= 5 ? std::max(1, atoi(argv[4])) : 3;
+        if (!fileExists(argv[2])) {
+            std::cerr << "File not found.\n";
+            return 1;
+        }
+        autotune(argv[2], backend, repeats);
+        return 0;
+    }
+
+    // OESP1 <file> [buffered|direct] - one read with the tuned configuration
+    if (argc >= 2) {
+        if (argc >= 3 && !parse_backend(argv[2], backend)) {
+            std::cerr << "Unknown backend: " << argv[2] << "\n";
+            return 1;
+        }
+        if (!fileExists(argv[1])) {
+            std::cerr << "File not found.\n";
+            return 1;
+        }
+        return read_file_multithread(argv[1], tuned_or_default_config(argv[1], backend), backend, true) < 0 ? 1 : 0;
+    }
+
+    std::string fileName;
+    int numThreads;
+
+    while (true)
+    {
+        std::cout << "Enter file name to read: ";
+        std::cin >> fileName;
+        std::cout << "Enter thread count (0 - tuned configuration): ";
+        std::cin >> numThreads;
+        if (!std::cin) {
+            break;
+        }
+        if (!fileExists(fileName)) {
+            std::cerr << "File not found.\n";
+            continue;
+        }
+        ReadConfig config = tuned_or_default_config(fileName, backend);
+        if (numThreads > 0) {
+            config.numThreads = numThreads;
+        }
+        read_file_multithread(fileName, config, backend, true);
+    }
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Просмотр живых метрик QueueSystem без остановки системы:
+//   QueueMonitor <pid> [период_мс]
+// Читает снимок, который сэмплер QueueSystem публикует в разделяемой памяти.
+#include "QueueSystem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Согласованная копия снимка по протоколу seqlock: копия принимается,
+// если sequence чётно и не изменилось за время копирования
+BOOL ReadSnapshot(const MetricsSnapshot* shared, MetricsSnapshot* snapshot) {
+    for (DWORD attempt = 0; attempt < 1000; attempt++) {
+        LONG sequence = shared->sequence;
+        if (sequence & 1) {
+            YieldProcessor();
+            continue;
+        }
+        MemoryBarrier();
+        memcpy(snapshot, (const void*)shared, sizeof(MetricsSnapshot));
+        MemoryBarrier();
+        if (shared->sequence == sequence) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void PrintSnapshot(const MetricsSnapshot* snapshot) {
+    printf("\n[%.1f s] sample %llu, interval %d ms, sampler overhead %.4f%%%s\n",
+        snapshot->elapsedTime / 1000.0, snapshot->sampleCount, snapshot->sampleInterval,
+        snapshot->samplerOverhead * 100, snapshot->running ? "" : " (stopped)");
+    printf("Stage  Depth  InFlight  Active  Util  Arrived  Dropped  Done    Thru/s   Mean ms  p50 ms   p95 ms   p99 ms\n");
+    for (DWORD i = 0; i < snapshot->stageCount && i < METRICS_MAX_STAGES; i++) {
+        const StageMetrics* stage = &snapshot->stages[i];
+        printf("%-6d %-6d %-9d %-7d %3.0f%%  %-8d %-8d %-7d %-8.2f %-8.2f %-8.2f %-8.2f %-8.2f\n",
+            i + 1, stage->queueDepth, stage->inFlight, stage->activeChannels, stage->utilization * 100,
+            stage->totalRequests, stage->droppedRequests, stage->completedRequests,
+            stage->throughput, stage->meanLatency, stage->p50Latency,
+            stage->p95Latency, stage->p99Latency);
+        for (DWORD j = 0; j < stage->channelCount && j < METRICS_MAX_CHANNELS; j++) {
+            const ChannelMetrics* channel = &stage->channels[j];
+            printf("  Channel %d: %s%s, processed %d, %.2f/s, utilization %.0f%% (+%.0f%% stolen), "
+                "mean %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms\n", j + 1,
+                channel->active ? "active" : "parked", channel->inFlight ? ", busy" : "",
+                channel->processedRequests, channel->throughput, channel->utilization * 100,
+                channel->stolenUtilization * 100, channel->meanLatency, channel->p50Latency,
+                channel->p95Latency, channel->p99Latency);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    char name[64];
+    MetricsSnapshot snapshot;
+
+    if (argc < 2) {
+        printf("Usage: QueueMonitor <pid> [interval_ms]\n");
+        return 1;
+    }
+    DWORD processId = strtoul(argv[1], NULL, 10);
+    DWORD interval = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+
+    sprintf_s(name, sizeof(name), METRICS_MAPPING_NAME, processId);
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (!mapping) {
+        printf("Cannot open %s (error %lu)\n", name, GetLastError());
+        return 1;
+    }
+    const MetricsSnapshot* shared = (const MetricsSnapshot*)MapViewOfFile(mapping,
+        FILE_MAP_READ, 0, 0, sizeof(MetricsSnapshot));
+    if (!shared) {
+        printf("Cannot map %s (error %lu)\n", name, GetLastError());
+        CloseHandle(mapping);
+        return 1;
+    }
+    // Без дескриптора процесса монитор завершается по флагу running снимка
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, processId);
+
+    for (;;) {
+        BOOL exited = FALSE;
+        if (process) {
+            exited = WaitForSingleObject(process, interval) == WAIT_OBJECT_0;
+        } else {
+            Sleep(interval);
+        }
+        if (!ReadSnapshot(shared, &snapshot)) {
+            printf("Snapshot is being rewritten too often, retrying\n");
+            continue;
+        }
+        if (snapshot.sampleCount > 0) {
+            PrintSnapshot(&snapshot);
+        }
+        if (exited || (snapshot.sampleCount > 0 && !snapshot.running)) {
+            break;
+        }
+    }
+
+    if (process) {
+        CloseHandle(process);
+    }
+    UnmapViewOfFile(shared);
+    CloseHandle(mapping);
+    return 0;
+}
@@ -1,150 +1,1608 @@
 #include "QueueSystem.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 // Глобальные переменные для статистики
 CRITICAL_SECTION statsCriticalSection;
 StageStats* globalStats = NULL;
 SystemParameters globalParams = {0};
-BOOL isSystemRunning = TRUE;
+volatile BOOL isSystemRunning = TRUE;
+HANDLE shutdownEvent = NULL;
+ULONGLONG shutdownTime = 0;     // мкс, момент остановки; читается после shutdownEvent
+StageQueue* stageQueues = NULL;
+LatencyHistogram systemSojourn = {0};
+TraceEntry* traceEntries = NULL;
+DWORD traceLength = 0;
+DWORD* serviceSamples = NULL;
+DWORD serviceSampleCount = 0;
+volatile LONG nextRequestId = 0;
+GeneratorParams* generators = NULL;
+double* burstSchedule = NULL;
+DWORD burstScheduleLength = 0;
+ScalingEvent* scalingLog = NULL;
+DWORD scalingLogSize = 0;
+DWORD scalingLogCapacity = 0;
+char metricsName[64] = "";
+MetricsSnapshot* metricsView = NULL;
 
-// Функция генерации случайного времени обработки
-DWORD GetRandomProcessingTime(DWORD min, DWORD max) {
-    return min + (rand() % (max - min + 1));
+ULONGLONG RotateLeft(ULONGLONG value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
 }
 
-// Функция потока-генератора заявок
+// xoshiro256**
+ULONGLONG NextRandom(ULONGLONG* state) {
+    ULONGLONG result = RotateLeft(state[1] * 5, 7) * 9;
+    ULONGLONG t = state[1] << 17;
+
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = RotateLeft(state[3], 45);
+    return result;
+}
+
+// Сдвиг на 2^128 шагов: отрезки последовательности разных генераторов не пересекаются
+void JumpRandom(ULONGLONG* state) {
+    const ULONGLONG jump[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    ULONGLONG next[4] = {0};
+
+    for (DWORD i = 0; i < 4; i++) {
+        for (int bit = 0; bit < 64; bit++) {
+            if (jump[i] & (1ULL << bit)) {
+                next[0] ^= state[0];
+                next[1] ^= state[1];
+                next[2] ^= state[2];
+                next[3] ^= state[3];
+            }
+            NextRandom(state);
+        }
+    }
+    memcpy(state, next, sizeof(next));
+}
+
+// Заполнение состояния из seed через splitmix64
+void SeedRandom(ULONGLONG* state, ULONGLONG seed) {
+    for (DWORD i = 0; i < 4; i++) {
+        seed += 0x9e3779b97f4a7c15ULL;
+        ULONGLONG z = seed;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        state[i] = z ^ (z >> 31);
+    }
+}
+
+// Равномерное число из [0, 1)
+double RandomDouble(ULONGLONG* state) {
+    return (NextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Равномерное целое из [min, max] без смещения по модулю
+DWORD RandomRange(ULONGLONG* state, DWORD min, DWORD max) {
+    ULONGLONG range = (ULONGLONG)max - min + 1;
+    ULONGLONG limit = ~0ULL - ~0ULL % range;
+    ULONGLONG value;
+
+    do {
+        value = NextRandom(state);
+    } while (value >= limit);
+    return min + (DWORD)(value % range);
+}
+
+double RandomExponential(ULONGLONG* state, double mean) {
+    return -mean * log(1.0 - RandomDouble(state));
+}
+
+// Логнормальное с заданным средним: μ = ln(mean) - σ²/2, нормальная величина по Боксу - Мюллеру
+double RandomLognormal(ULONGLONG* state, double mean, double sigma) {
+    double u = 1.0 - RandomDouble(state);
+    double normal = sqrt(-2.0 * log(u)) * cos(2.0 * 3.14159265358979323846 * RandomDouble(state));
+    return exp(log(mean) - sigma * sigma / 2 + sigma * normal);
+}
+
+// Монотонное время в микросекундах
+ULONGLONG GetMonotonicMicroseconds() {
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (ULONGLONG)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+        (ULONGLONG)(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+const char* GetDisciplineName(QueueDiscipline discipline) {
+    switch (discipline) {
+    case DISCIPLINE_SJF: return "SJF";
+    case DISCIPLINE_EDF: return "EDF";
+    case DISCIPLINE_PRIORITY: return "PRIORITY";
+    default: return "FIFO";
+    }
+}
+
+const char* GetArrivalProcessName(ArrivalProcess process) {
+    switch (process) {
+    case ARRIVAL_POISSON: return "POISSON";
+    case ARRIVAL_MMPP: return "MMPP";
+    case ARRIVAL_TRACE: return "TRACE";
+    default: return "FIXED";
+    }
+}
+
+const char* GetServiceDistributionName(ServiceDistribution distribution) {
+    switch (distribution) {
+    case SERVICE_EXPONENTIAL: return "EXPONENTIAL";
+    case SERVICE_LOGNORMAL: return "LOGNORMAL";
+    case SERVICE_EMPIRICAL: return "EMPIRICAL";
+    default: return "UNIFORM";
+    }
+}
+
+// Номер корзины гистограммы для задержки value (мкс)
+DWORD GetLatencyBucket(ULONGLONG value) {
+    if (value < LATENCY_SUB_BUCKETS) {
+        return (DWORD)value;
+    }
+    DWORD exponent = 0;
+    for (ULONGLONG v = value; v > 1; v >>= 1) {
+        exponent++;
+    }
+    return (exponent - 3) * LATENCY_SUB_BUCKETS +
+        (DWORD)((value >> (exponent - 4)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+// Середина диапазона корзины, мкс
+ULONGLONG GetLatencyBucketValue(DWORD bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    DWORD exponent = bucket / LATENCY_SUB_BUCKETS + 3;
+    ULONGLONG width = 1ULL << (exponent - 4);
+    return (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) * width + width / 2;
+}
+
+// Вызывается под statsCriticalSection
+void RecordLatency(LatencyHistogram* histogram, ULONGLONG value) {
+    histogram->count++;
+    histogram->sum += value;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    histogram->buckets[GetLatencyBucket(value)]++;
+}
+
+ULONGLONG GetLatencyPercentile(const LatencyHistogram* histogram, double percentile) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+    ULONGLONG target = (ULONGLONG)(histogram->count * percentile / 100.0);
+    if (target == 0) {
+        target = 1;
+    }
+    ULONGLONG seen = 0;
+    for (DWORD i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= target) {
+            ULONGLONG value = GetLatencyBucketValue(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void PrintLatency(const char* title, const LatencyHistogram* histogram) {
+    printf("%s: mean %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n", title,
+        histogram->count ? (double)histogram->sum / histogram->count / 1000.0 : 0,
+        GetLatencyPercentile(histogram, 50) / 1000.0,
+        GetLatencyPercentile(histogram, 95) / 1000.0,
+        GetLatencyPercentile(histogram, 99) / 1000.0,
+        histogram->max / 1000.0);
+}
+
+void InitializeStageQueue(StageQueue* queue, DWORD capacity, QueueDiscipline discipline,
+    DWORD agingInterval) {
+    InitializeCriticalSection(&queue->lock);
+    InitializeConditionVariable(&queue->notEmpty);
+    InitializeConditionVariable(&queue->parked);
+    queue->discipline = discipline;
+    queue->heap = NULL;
+    queue->classes = 0;
+    if (discipline == DISCIPLINE_SJF || discipline == DISCIPLINE_EDF) {
+        queue->heap = (Request**)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+            sizeof(Request*) * capacity);
+    } else {
+        queue->classes = discipline == DISCIPLINE_PRIORITY ? PRIORITY_CLASS_COUNT : 1;
+    }
+    for (DWORD i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        queue->classBuffers[i] = i < queue->classes ?
+            (Request**)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Request*) * capacity) :
+            NULL;
+        queue->classHead[i] = 0;
+        queue->classCount[i] = 0;
+    }
+    queue->agingInterval = (ULONGLONG)agingInterval * 1000;
+    queue->nextSequence = 0;
+    queue->capacity = capacity;
+    queue->count = 0;
+    queue->activeChannels = 0;
+    queue->waitingChannels = 0;
+}
+
+void DeleteStageQueue(StageQueue* queue) {
+    if (queue->heap) {
+        for (DWORD i = 0; i < queue->count; i++) {
+            HeapFree(GetProcessHeap(), 0, queue->heap[i]);
+        }
+        HeapFree(GetProcessHeap(), 0, queue->heap);
+    }
+    for (DWORD i = 0; i < queue->classes; i++) {
+        for (DWORD j = 0; j < queue->classCount[i]; j++) {
+            HeapFree(GetProcessHeap(), 0,
+                queue->classBuffers[i][(queue->classHead[i] + j) % queue->capacity]);
+        }
+        HeapFree(GetProcessHeap(), 0, queue->classBuffers[i]);
+    }
+    DeleteCriticalSection(&queue->lock);
+}
+
+// Порядок заявок в куче: ключ дисциплины, при равенстве - порядок поступления
+BOOL RequestPrecedes(const StageQueue* queue, const Request* a, const Request* b) {
+    if (queue->discipline == DISCIPLINE_SJF && a->processingTime != b->processingTime) {
+        return a->processingTime < b->processingTime;
+    }
+    if (queue->discipline == DISCIPLINE_EDF && a->deadline != b->deadline) {
+        return a->deadline < b->deadline;
+    }
+    return a->sequence < b->sequence;
+}
+
+void PushRequestHeap(StageQueue* queue, Request* request) {
+    DWORD i = queue->count;
+    while (i > 0) {
+        DWORD parent = (i - 1) / 2;
+        if (!RequestPrecedes(queue, request, queue->heap[parent])) break;
+        queue->heap[i] = queue->heap[parent];
+        i = parent;
+    }
+    queue->heap[i] = request;
+}
+
+Request* PopRequestHeap(StageQueue* queue) {
+    Request* top = queue->heap[0];
+    Request* last = queue->heap[queue->count - 1];
+    DWORD size = queue->count - 1;
+    DWORD i = 0;
+
+    while (2 * i + 1 < size) {
+        DWORD child = 2 * i + 1;
+        if (child + 1 < size && RequestPrecedes(queue, queue->heap[child + 1], queue->heap[child])) {
+            child++;
+        }
+        if (!RequestPrecedes(queue, queue->heap[child], last)) break;
+        queue->heap[i] = queue->heap[child];
+        i = child;
+    }
+    if (size > 0) {
+        queue->heap[i] = last;
+    }
+    return top;
+}
+
+// Выбор класса со старением: каждые agingInterval мкс ожидания поднимают
+// заявку на один класс. Внутри класса очередь упорядочена по времени
+// поступления, поэтому достаточно сравнить головы классов.
+DWORD SelectPriorityClass(const StageQueue* queue, ULONGLONG now) {
+    DWORD best = 0;
+    LONGLONG bestScore = 0;
+    BOOL found = FALSE;
+
+    for (DWORD i = 0; i < queue->classes; i++) {
+        if (queue->classCount[i] == 0) continue;
+
+        Request* head = queue->classBuffers[i][queue->classHead[i]];
+        LONGLONG score = (LONGLONG)(i * queue->agingInterval) - (LONGLONG)(now - head->enqueueTime);
+        if (!found || score < bestScore) {
+            best = i;
+            bestScore = score;
+            found = TRUE;
+        }
+    }
+    return best;
+}
+
+// Будит один простаивающий канал другой ступени, чтобы он забрал заявку
+void WakeIdleThief(const StageQueue* queue) {
+    for (DWORD i = 0; i < globalParams.stageCount; i++) {
+        if (&stageQueues[i] != queue && stageQueues[i].waitingChannels > 0) {
+            WakeConditionVariable(&stageQueues[i].notEmpty);
+            return;
+        }
+    }
+}
+
+// Постановка заявки в буфер без ожидания: при заполненном буфере
+// заявка отклоняется, и вызывающий учитывает её как потерянную
+BOOL TryEnqueueRequest(StageQueue* queue, Request* request) {
+    BOOL enqueued = FALSE;
+    BOOL backlogged = FALSE;
+    ULONGLONG now = GetMonotonicMicroseconds();
+
+    EnterCriticalSection(&queue->lock);
+    if (queue->count < queue->capacity) {
+        request->enqueueTime = now;
+        request->sequence = queue->nextSequence++;
+        if (queue->heap) {
+            PushRequestHeap(queue, request);
+        } else {
+            DWORD cls = request->priorityClass < queue->classes ?
+                request->priorityClass : queue->classes - 1;
+            queue->classBuffers[cls][(queue->classHead[cls] + queue->classCount[cls]) % queue->capacity] =
+                request;
+            queue->classCount[cls]++;
+        }
+        queue->count++;
+        enqueued = TRUE;
+        backlogged = queue->waitingChannels == 0;
+    }
+    LeaveCriticalSection(&queue->lock);
+
+    if (enqueued) {
+        WakeConditionVariable(&queue->notEmpty);
+        if (backlogged && globalParams.workStealing) {
+            WakeIdleThief(queue);
+        }
+    }
+    return enqueued;
+}
+
+// Извлечение заявки по дисциплине буфера; вызывается под queue->lock при count > 0
+Request* PopRequest(StageQueue* queue) {
+    Request* request;
+
+    if (queue->heap) {
+        request = PopRequestHeap(queue);
+    } else {
+        DWORD cls = SelectPriorityClass(queue, GetMonotonicMicroseconds());
+        request = queue->classBuffers[cls][queue->classHead[cls]];
+        queue->classHead[cls] = (queue->classHead[cls] + 1) % queue->capacity;
+        queue->classCount[cls]--;
+    }
+    queue->count--;
+    return request;
+}
+
+// Кража заявки из самой глубокой чужой очереди, у которой нет свободных
+// собственных каналов. Глубины читаются без блокировок и перепроверяются
+// под блокировкой выбранной очереди.
+Request* TryStealRequest(DWORD thiefStage, DWORD* sourceStage) {
+    DWORD victim = thiefStage;
+    DWORD deepest = 0;
+    Request* request = NULL;
+
+    for (DWORD i = 0; i < globalParams.stageCount; i++) {
+        if (i == thiefStage || stageQueues[i].waitingChannels > 0) continue;
+        if (stageQueues[i].count > deepest) {
+            victim = i;
+            deepest = stageQueues[i].count;
+        }
+    }
+    if (victim == thiefStage) {
+        return NULL;
+    }
+
+    EnterCriticalSection(&stageQueues[victim].lock);
+    if (stageQueues[victim].count > 0 && stageQueues[victim].waitingChannels == 0) {
+        request = PopRequest(&stageQueues[victim]);
+        *sourceStage = victim;
+    }
+    LeaveCriticalSection(&stageQueues[victim].lock);
+
+    return request;
+}
+
+// Получение заявки каналом с ожиданием. Возвращает NULL после остановки
+// системы. В *sourceStage записывается ступень, из буфера которой взята
+// заявка. Время ожидания активного канала добавляется к *idleTime (мкс).
+Request* AcquireRequest(ChannelParams* params, ULONGLONG* idleTime, DWORD* sourceStage) {
+    StageQueue* queue = params->queue;
+    Request* request = NULL;
+
+    EnterCriticalSection(&queue->lock);
+    while (*params->isRunning && !request) {
+        if (params->channelId >= queue->activeChannels) {
+            SleepConditionVariableCS(&queue->parked, &queue->lock, INFINITE);
+            continue;
+        }
+        if (queue->count > 0) {
+            request = PopRequest(queue);
+            *sourceStage = params->stageId;
+            continue;
+        }
+        if (params->params->workStealing) {
+            LeaveCriticalSection(&queue->lock);
+            request = TryStealRequest(params->stageId, sourceStage);
+            EnterCriticalSection(&queue->lock);
+            if (request || queue->count > 0) continue;
+        }
+        if (!*params->isRunning || params->channelId >= queue->activeChannels) continue;
+
+        ULONGLONG waitStart = GetMonotonicMicroseconds();
+        queue->waitingChannels++;
+        SleepConditionVariableCS(&queue->notEmpty, &queue->lock, INFINITE);
+        queue->waitingChannels--;
+        *idleTime += GetMonotonicMicroseconds() - waitStart;
+    }
+    LeaveCriticalSection(&queue->lock);
+
+    return request;
+}
+
+// Остановка системы: флаг выставляется до пробуждения, а каждая очередь
+// будится под своей блокировкой, поэтому ни один канал не пропустит сигнал
+void SignalShutdown() {
+    shutdownTime = GetMonotonicMicroseconds();
+    isSystemRunning = FALSE;
+    SetEvent(shutdownEvent);
+
+    for (DWORD i = 0; i < globalParams.stageCount; i++) {
+        EnterCriticalSection(&stageQueues[i].lock);
+        WakeAllConditionVariable(&stageQueues[i].notEmpty);
+        WakeAllConditionVariable(&stageQueues[i].parked);
+        LeaveCriticalSection(&stageQueues[i].lock);
+    }
+}
+
+DWORD SampleProcessingTime(GeneratorParams* generator) {
+    double value;
+
+    switch (globalParams.serviceDistribution) {
+    case SERVICE_EXPONENTIAL:
+        value = RandomExponential(generator->random, globalParams.meanProcessingTime);
+        break;
+    case SERVICE_LOGNORMAL:
+        value = RandomLognormal(generator->random, globalParams.meanProcessingTime,
+            globalParams.processingTimeSigma);
+        break;
+    case SERVICE_EMPIRICAL:
+        if (serviceSampleCount > 0) {
+            return serviceSamples[RandomRange(generator->random, 0, serviceSampleCount - 1)];
+        }
+        // Без выборки - равномерное
+    default:
+        return RandomRange(generator->random, globalParams.minProcessingTime,
+            globalParams.maxProcessingTime);
+    }
+    return value < 4294967295.0 ? (DWORD)(value + 0.5) : 4294967295UL;
+}
+
+// Общее для всех генераторов расписание MMPP: burstSchedule[k] - конец
+// k-го состояния в мкс от начала, чётные состояния - фон, нечётные - пачки.
+// Пачки у всех генераторов совпадают, поэтому суммарная интенсивность
+// внутри пачки - burstRate при любом generatorCount.
+void BuildBurstSchedule(ULONGLONG* random) {
+    DWORD capacity = 0;
+    double end = 0;
+
+    burstScheduleLength = 0;
+    while (end < 1000.0 * globalParams.simulationTime) {
+        if (burstScheduleLength == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            burstSchedule = (double*)(burstSchedule ?
+                HeapReAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, burstSchedule, sizeof(double) * capacity) :
+                HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(double) * capacity));
+        }
+        end += RandomExponential(random, 1000.0 *
+            (burstScheduleLength & 1 ? globalParams.burstDuration : globalParams.burstInterval));
+        burstSchedule[burstScheduleLength++] = end;
+    }
+}
+
+// Момент следующего поступления после previous, в мкс от общего начала
+// работы генераторов. Расписание хранится в double, чтобы дробные интервалы не
+// усекались и не смещали интенсивность. Поток делится между генераторами
+// поровну, поэтому интенсивность каждого генератора - arrivalRate /
+// generatorCount. Возвращает -1, когда трасса исчерпана.
+double NextArrivalTime(GeneratorParams* generator, double previous) {
+    double meanGap = 1000000.0 * globalParams.generatorCount / globalParams.arrivalRate;
+
+    switch (globalParams.arrivalProcess) {
+    case ARRIVAL_POISSON:
+        return previous + RandomExponential(generator->random, meanGap);
+    case ARRIVAL_MMPP:
+        // Экспоненциальные интервалы без памяти: при смене состояния
+        // отсчёт следующего поступления начинается заново с момента смены.
+        // За концом расписания последнее состояние длится до остановки
+        for (;;) {
+            double rate = generator->burstState & 1 ? globalParams.burstRate : globalParams.arrivalRate;
+            double next = previous + RandomExponential(generator->random,
+                1000000.0 * globalParams.generatorCount / rate);
+            if (generator->burstState >= burstScheduleLength ||
+                next <= burstSchedule[generator->burstState]) {
+                return next;
+            }
+            previous = burstSchedule[generator->burstState];
+            generator->burstState++;
+        }
+    case ARRIVAL_TRACE:
+        if (generator->traceIndex >= traceLength) {
+            return -1;
+        }
+        return traceEntries[generator->traceIndex].offset * 1000;
+    default:
+        return previous + meanGap;
+    }
+}
+
+// Ожидание абсолютного момента deadline на таймере высокого разрешения.
+// Возвращает FALSE при остановке системы.
+BOOL WaitUntil(HANDLE timer, ULONGLONG deadline) {
+    ULONGLONG now = GetMonotonicMicroseconds();
+    HANDLE handles[2] = { shutdownEvent, timer };
+    LARGE_INTEGER dueTime;
+
+    if (deadline <= now) {
+        return WaitForSingleObject(shutdownEvent, 0) == WAIT_TIMEOUT;
+    }
+    // Отрицательное значение - относительный срок в интервалах по 100 нс
+    dueTime.QuadPart = -(LONGLONG)((deadline - now) * 10);
+    SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE);
+    return WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0;
+}
+
+// Функция потока-генератора заявок. Открытая модель: моменты поступления
+// задаются расписанием и не зависят от состояния системы. Генератор спит
+// до абсолютного момента очередной заявки, а после пробуждения выдаёт
+// все заявки, срок которых уже наступил, поэтому при интенсивностях выше
+// разрешения таймера заявки выдаются пачками без накопления отставания.
 DWORD WINAPI RequestGenerator(LPVOID lpParam) {
-    HANDLE bufferSemaphore = ((ChannelParams*)lpParam)->bufferSemaphore;
-    HANDLE bufferMutex = ((ChannelParams*)lpParam)->bufferMutex;
-    Request** buffer = ((ChannelParams*)lpParam)->buffer;
-    DWORD* currentBufferSize = ((ChannelParams*)lpParam)->currentBufferSize;
-    DWORD bufferSize = *((ChannelParams*)lpParam)->bufferSize;
-    StageStats* stats = ((ChannelParams*)lpParam)->stats;
+    GeneratorParams* generator = (GeneratorParams*)lpParam;
+    StageQueue* queue = generator->queue;
+    StageStats* stats = generator->stats;
     
-    DWORD requestId = 0;
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+        TIMER_ALL_ACCESS);
+    if (!timer) {
+        timer = CreateWaitableTimer(NULL, TRUE, NULL);
+    }
     
-    while (isSystemRunning) {
-        Sleep(globalParams.requestGenerationRate);
-        
-        Request* newRequest = (Request*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Request));
-        if (!newRequest) continue;
+    ULONGLONG startTime = generator->startTime;
+    generator->burstState = 0;
+    generator->traceIndex = generator->generatorId;
+    // Равномерные потоки генераторов сдвинуты по фазе: первое поступление
+    // генератора i - через i + 1 шагов общего потока, поэтому суммарный поток
+    // идёт с шагом 1 / arrivalRate, а не пачками по generatorCount заявок
+    double nextArrival = globalParams.arrivalProcess == ARRIVAL_FIXED ?
+        1000000.0 * (generator->generatorId + 1) / globalParams.arrivalRate :
+        NextArrivalTime(generator, 0);
+    
+    while (nextArrival >= 0 && WaitUntil(timer, startTime + (ULONGLONG)nextArrival)) {
+        ULONGLONG now = GetMonotonicMicroseconds();
         
-        newRequest->id = requestId++;
-        newRequest->creationTime = GetTickCount();
-        newRequest->processingTime = GetRandomProcessingTime(
-            globalParams.minProcessingTime,
-            globalParams.maxProcessingTime
-        );
-
-        // Ожидание места в буфере
-        if (WaitForSingleObject(bufferSemaphore, 100) == WAIT_OBJECT_0) {
-            WaitForSingleObject(bufferMutex, INFINITE);
+        while (nextArrival >= 0 && startTime + (ULONGLONG)nextArrival <= now && isSystemRunning) {
+            ULONGLONG arrivalTime = startTime + (ULONGLONG)nextArrival;
+            Request* newRequest = (Request*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Request));
+            if (!newRequest) break;
             
-            buffer[*currentBufferSize] = newRequest;
-            (*currentBufferSize)++;
+            newRequest->id = (DWORD)InterlockedIncrement(&nextRequestId) - 1;
+            newRequest->creationTime = GetTickCount();
+            newRequest->processingTime = globalParams.arrivalProcess == ARRIVAL_TRACE &&
+                traceEntries[generator->traceIndex].processingTime ?
+                traceEntries[generator->traceIndex].processingTime : SampleProcessingTime(generator);
+            newRequest->priorityClass = RandomRange(generator->random, 0, PRIORITY_CLASS_COUNT - 1);
+            newRequest->arrivalTime = arrivalTime;
+            newRequest->deadline = newRequest->arrivalTime + (ULONGLONG)RandomRange(generator->random,
+                globalParams.minDeadline,
+                globalParams.maxDeadline
+            ) * 1000;
             
-            EnterCriticalSection(&statsCriticalSection);
-            stats->totalRequests++;
-            LeaveCriticalSection(&statsCriticalSection);
+            generator->emittedRequests++;
+            generator->totalLag += now - arrivalTime;
+            if (now - arrivalTime > generator->maxLag) {
+                generator->maxLag = now - arrivalTime;
+            }
             
-            ReleaseMutex(bufferMutex);
-        } else {
-            EnterCriticalSection(&statsCriticalSection);
-            stats->droppedRequests++;
-            LeaveCriticalSection(&statsCriticalSection);
-            HeapFree(GetProcessHeap(), 0, newRequest);
+            if (TryEnqueueRequest(queue, newRequest)) {
+                EnterCriticalSection(&statsCriticalSection);
+                stats->totalRequests++;
+                LeaveCriticalSection(&statsCriticalSection);
+            } else {
+                EnterCriticalSection(&statsCriticalSection);
+                stats->droppedRequests++;
+                LeaveCriticalSection(&statsCriticalSection);
+                HeapFree(GetProcessHeap(), 0, newRequest);
+            }
+            
+            generator->traceIndex += globalParams.generatorCount;
+            nextArrival = NextArrivalTime(generator, nextArrival);
         }
     }
+    
+    CloseHandle(timer);
     return 0;
 }
 
 // Функция потока-обработчика (канала)
 DWORD WINAPI ChannelProcessor(LPVOID lpParam) {
     ChannelParams* params = (ChannelParams*)lpParam;
-    DWORD stageId = params->stageId;
     DWORD channelId = params->channelId;
     
-    while (isSystemRunning) {
-        if (WaitForSingleObject(params->bufferSemaphore, 100) == WAIT_OBJECT_0) {
-            WaitForSingleObject(params->bufferMutex, INFINITE);
+    while (*params->isRunning) {
+        ULONGLONG idleTime = 0;
+        DWORD stageId = params->stageId;
+        Request* request = AcquireRequest(params, &idleTime, &stageId);
+        
+        EnterCriticalSection(&statsCriticalSection);
+        params->stats->channelStats[channelId].idleTime += idleTime;
+        LeaveCriticalSection(&statsCriticalSection);
+        
+        if (request) {
+            // Украденная заявка учитывается и передаётся дальше от имени
+            // ступени, из буфера которой она взята
+            StageStats* stageStats = &globalStats[stageId];
+            InterlockedIncrement(&stageStats->inFlight);
+            InterlockedIncrement(&params->stats->channelStats[channelId].inFlight);
+            DWORD startTime = GetTickCount();
+            // Обслуживание прерывается остановкой: незавершённая заявка
+            // не учитывается и не передаётся дальше. Так же отбрасывается
+            // заявка, завершившаяся уже после остановки, чтобы итоги
+            // учитывали только работу в пределах simulationTime
+            if (WaitForSingleObject(shutdownEvent, request->processingTime) != WAIT_TIMEOUT ||
+                !*params->isRunning) {
+                InterlockedDecrement(&stageStats->inFlight);
+                InterlockedDecrement(&params->stats->channelStats[channelId].inFlight);
+                HeapFree(GetProcessHeap(), 0, request);
+                break;
+            }
+            DWORD endTime = GetTickCount();
+            ULONGLONG completionTime = GetMonotonicMicroseconds();
             
-            Request* request = NULL;
-            if (*params->currentBufferSize > 0) {
-                request = params->buffer[0];
-                
-                for (DWORD i = 0; i < *params->currentBufferSize - 1; i++) {
-                    params->buffer[i] = params->buffer[i + 1];
+            EnterCriticalSection(&statsCriticalSection);
+            params->stats->channelStats[channelId].processedRequests++;
+            params->stats->channelStats[channelId].totalProcessingTime += 
+                endTime - startTime;
+            stageStats->busyTime += endTime - startTime;
+            if (stageId != params->stageId) {
+                params->stats->channelStats[channelId].stolenRequests++;
+                params->stats->channelStats[channelId].stolenProcessingTime += endTime - startTime;
+            }
+            RecordLatency(&stageStats->sojourn, completionTime - request->enqueueTime);
+            RecordLatency(&params->stats->channelStats[channelId].sojourn,
+                completionTime - request->enqueueTime);
+            if (stageId == globalParams.stageCount - 1) {
+                RecordLatency(&systemSojourn, completionTime - request->arrivalTime);
+                if (completionTime > request->deadline) {
+                    stageStats->missedDeadlines++;
                 }
-                (*params->currentBufferSize)--;
             }
+            LeaveCriticalSection(&statsCriticalSection);
+            InterlockedDecrement(&stageStats->inFlight);
+            InterlockedDecrement(&params->stats->channelStats[channelId].inFlight);
             
-            ReleaseMutex(params->bufferMutex);
-            
-            if (request) {
-                DWORD startTime = GetTickCount();
-                Sleep(request->processingTime);
-                DWORD endTime = GetTickCount();
-                
-                EnterCriticalSection(&statsCriticalSection);
-                params->stats->channelStats[channelId].processedRequests++;
-                params->stats->channelStats[channelId].totalProcessingTime += 
-                    endTime - startTime;
-                LeaveCriticalSection(&statsCriticalSection);
-                
-                if (stageId < globalParams.stageCount - 1) {
-                    // Логика передачи в следующую ступень
+            if (stageId < globalParams.stageCount - 1) {
+                // Передача в следующую ступень; при заполненном буфере заявка теряется
+                if (TryEnqueueRequest(&stageQueues[stageId + 1], request)) {
+                    EnterCriticalSection(&statsCriticalSection);
+                    globalStats[stageId + 1].totalRequests++;
+                    LeaveCriticalSection(&statsCriticalSection);
+                } else {
+                    EnterCriticalSection(&statsCriticalSection);
+                    globalStats[stageId + 1].droppedRequests++;
+                    LeaveCriticalSection(&statsCriticalSection);
+                    HeapFree(GetProcessHeap(), 0, request);
                 }
-                
+            } else {
                 HeapFree(GetProcessHeap(), 0, request);
             }
-        } else {
+        }
+    }
+    return 0;
+}
+
+// Изменение числа активных каналов ступени в пределах [minChannels, maxChannels]
+void SetActiveChannels(DWORD stageId, DWORD channels, ULONGLONG startTime,
+    DWORD queueDepth, double arrivalRate, double utilization) {
+    StageQueue* queue = &stageQueues[stageId];
+    DWORD fromChannels;
+
+    EnterCriticalSection(&queue->lock);
+    fromChannels = queue->activeChannels;
+    queue->activeChannels = channels;
+    // Лишние каналы уходят из ожидания заявок в parked, новые - наоборот
+    WakeAllConditionVariable(channels > fromChannels ? &queue->parked : &queue->notEmpty);
+    LeaveCriticalSection(&queue->lock);
+
+    ScalingEvent event;
+    event.time = (DWORD)((GetMonotonicMicroseconds() - startTime) / 1000);
+    event.stageId = stageId;
+    event.fromChannels = fromChannels;
+    event.toChannels = channels;
+    event.queueDepth = queueDepth;
+    event.arrivalRate = arrivalRate;
+    event.utilization = utilization;
+
+    if (scalingLogSize == scalingLogCapacity) {
+        scalingLogCapacity = scalingLogCapacity ? scalingLogCapacity * 2 : 16;
+        scalingLog = (ScalingEvent*)(scalingLog ?
+            HeapReAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, scalingLog, sizeof(ScalingEvent) * scalingLogCapacity) :
+            HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ScalingEvent) * scalingLogCapacity));
+    }
+    scalingLog[scalingLogSize++] = event;
+
+    EnterCriticalSection(&statsCriticalSection);
+    if (channels > fromChannels) {
+        globalStats[stageId].scaleUps++;
+    } else {
+        globalStats[stageId].scaleDowns++;
+    }
+    LeaveCriticalSection(&statsCriticalSection);
+
+    printf("[%.1f s] Stage %d: %d -> %d channels (depth %d, arrivals %.2f/s, utilization %.0f%%)\n",
+        event.time / 1000.0, stageId + 1, fromChannels, channels, queueDepth,
+        arrivalRate, utilization * 100);
+}
+
+// Функция потока-контроллера масштабирования. Раз в scalingInterval
+// оценивает глубину очереди, интенсивность поступления и загрузку каждой
+// ступени и отдаёт канал самой перегруженной ступени: из свободного
+// бюджета или забирая его у наименее загруженной.
+DWORD WINAPI ScalingController(LPVOID lpParam) {
+    DWORD stageCount = globalParams.stageCount;
+    DWORD* lastArrivals = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    DWORD* lastBusyTime = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    double* utilization = (double*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(double) * stageCount);
+    double* arrivalRate = (double*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(double) * stageCount);
+    DWORD* queueDepth = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    DWORD* activeChannels = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    DWORD* coldIntervals = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    ULONGLONG startTime = GetMonotonicMicroseconds();
+    ULONGLONG lastTime = startTime;
+    
+    while (WaitForSingleObject(shutdownEvent, globalParams.scalingInterval) == WAIT_TIMEOUT) {
+        ULONGLONG now = GetMonotonicMicroseconds();
+        double elapsed = (now - lastTime) / 1000.0;
+        DWORD totalActive = 0;
+        DWORD hot = stageCount;
+        DWORD cold = stageCount;
+        lastTime = now;
+        
+        for (DWORD i = 0; i < stageCount; i++) {
+            DWORD waitingChannels;
+            
+            EnterCriticalSection(&stageQueues[i].lock);
+            queueDepth[i] = stageQueues[i].count;
+            activeChannels[i] = stageQueues[i].activeChannels;
+            waitingChannels = stageQueues[i].waitingChannels;
+            LeaveCriticalSection(&stageQueues[i].lock);
+            
             EnterCriticalSection(&statsCriticalSection);
-            params->stats->channelStats[channelId].idleTime += 100;
+            DWORD arrivals = globalStats[i].totalRequests + globalStats[i].droppedRequests;
+            // Занятость ступени - обработка заявок из её буфера любыми каналами,
+            // чтобы помощь другим ступеням не выдавала ступень за перегруженную
+            DWORD busyTime = globalStats[i].busyTime;
+            globalStats[i].activeChannelTime += activeChannels[i] * elapsed;
             LeaveCriticalSection(&statsCriticalSection);
+            
+            // Время обработки учитывается по завершении заявки, поэтому
+            // загрузка сглаживается экспоненциальным средним
+            double sample = busyTime - lastBusyTime[i];
+            sample /= elapsed * (activeChannels[i] ? activeChannels[i] : 1);
+            utilization[i] = 0.5 * utilization[i] + 0.5 * (sample < 1.0 ? sample : 1.0);
+            arrivalRate[i] = (arrivals - lastArrivals[i]) * 1000.0 / elapsed;
+            lastArrivals[i] = arrivals;
+            lastBusyTime[i] = busyTime;
+            totalActive += activeChannels[i];
+            
+            // Ступень отдаёт канал, только если простаивает два периода подряд
+            if (queueDepth[i] == 0 && utilization[i] <= 0.5) {
+                coldIntervals[i]++;
+            } else {
+                coldIntervals[i] = 0;
+            }
+            
+            BOOL overloaded = (queueDepth[i] > 0 && waitingChannels == 0) || utilization[i] > 0.9;
+            if (overloaded && activeChannels[i] < globalParams.maxChannels[i] &&
+                (hot == stageCount || queueDepth[i] > queueDepth[hot] ||
+                (queueDepth[i] == queueDepth[hot] && utilization[i] > utilization[hot]))) {
+                hot = i;
+            }
+        }
+        
+        if (hot == stageCount) continue;
+        
+        for (DWORD i = 0; i < stageCount; i++) {
+            if (i == hot || coldIntervals[i] < 2 ||
+                activeChannels[i] <= globalParams.minChannels[i]) continue;
+            if (cold == stageCount || utilization[i] < utilization[cold]) {
+                cold = i;
+            }
+        }
+        
+        if (totalActive >= globalParams.channelBudget) {
+            if (cold == stageCount) continue;
+            SetActiveChannels(cold, activeChannels[cold] - 1, startTime,
+                queueDepth[cold], arrivalRate[cold], utilization[cold]);
         }
+        SetActiveChannels(hot, activeChannels[hot] + 1, startTime,
+            queueDepth[hot], arrivalRate[hot], utilization[hot]);
+    }
+    
+    // Учёт активных каналов за последний неполный период, до момента остановки
+    double elapsed = shutdownTime > lastTime ? (shutdownTime - lastTime) / 1000.0 : 0;
+    EnterCriticalSection(&statsCriticalSection);
+    for (DWORD i = 0; i < stageCount; i++) {
+        globalStats[i].activeChannelTime += stageQueues[i].activeChannels * elapsed;
     }
+    LeaveCriticalSection(&statsCriticalSection);
+    
+    HeapFree(GetProcessHeap(), 0, lastArrivals);
+    HeapFree(GetProcessHeap(), 0, lastBusyTime);
+    HeapFree(GetProcessHeap(), 0, utilization);
+    HeapFree(GetProcessHeap(), 0, arrivalRate);
+    HeapFree(GetProcessHeap(), 0, queueDepth);
+    HeapFree(GetProcessHeap(), 0, activeChannels);
+    HeapFree(GetProcessHeap(), 0, coldIntervals);
+    return 0;
+}
+
+// Чтение счётчика, который меняют другие потоки, без их блокировок.
+// Выровненный DWORD читается атомарно; снимок в целом согласован лишь
+// приблизительно, что для живого мониторинга допустимо.
+DWORD ReadCounter(const DWORD* value) {
+    return *(const volatile DWORD*)value;
+}
+
+// Публикация снимка по протоколу seqlock. Писатель один - сэмплер
+void PublishMetrics(MetricsSnapshot* shared, MetricsSnapshot* snapshot) {
+    snapshot->sequence = InterlockedIncrement(&shared->sequence);   // нечётное - идёт запись
+    memcpy((void*)shared, snapshot, sizeof(MetricsSnapshot));
+    InterlockedIncrement(&shared->sequence);
+}
+
+// Гистограмма периода - разность корзин histogram с корзинами last
+// предыдущего снимка, которые тут же обновляются; max не ограничивает
+// перцентили окна
+void ReadLatencyWindow(const LatencyHistogram* histogram, DWORD* last, LatencyHistogram* window) {
+    window->count = 0;
+    window->sum = 0;
+    window->max = ~0ULL;
+    for (DWORD b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+        DWORD value = ReadCounter(&histogram->buckets[b]);
+        window->buckets[b] = value - last[b];
+        window->count += window->buckets[b];
+        window->sum += window->buckets[b] * GetLatencyBucketValue(b);
+        last[b] = value;
+    }
+}
+
+// Функция потока-сэмплера живых метрик. Раз в metricsInterval снимает
+// глубину буферов, число заявок в обработке, пропускную способность и
+// перцентили времени пребывания за период по ступеням и каналам и публикует снимок в
+// разделяемой памяти. Блокировки рабочих потоков не берутся: счётчики
+// читаются напрямую, перцентили периода - по разности корзин гистограммы.
+// Собственное время сэмплера учитывается, и при выходе за
+// METRICS_OVERHEAD_BUDGET одного ядра период удваивается.
+DWORD WINAPI MetricsSampler(LPVOID lpParam) {
+    MetricsSnapshot* shared = (MetricsSnapshot*)lpParam;
+    DWORD stageCount = globalParams.stageCount < METRICS_MAX_STAGES ?
+        globalParams.stageCount : METRICS_MAX_STAGES;
+    MetricsSnapshot* snapshot = (MetricsSnapshot*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(MetricsSnapshot));
+    LatencyHistogram* window = (LatencyHistogram*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(LatencyHistogram));
+    DWORD* lastBuckets = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * LATENCY_BUCKET_COUNT * stageCount);
+    DWORD* lastChannelBuckets = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * LATENCY_BUCKET_COUNT * METRICS_MAX_CHANNELS * stageCount);
+    DWORD* lastBusyTime = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * METRICS_MAX_CHANNELS * stageCount);
+    DWORD* lastStolenTime = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * METRICS_MAX_CHANNELS * stageCount);
+    DWORD* lastStageBusyTime = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    DWORD interval = globalParams.metricsInterval;
+    ULONGLONG startTime = GetMonotonicMicroseconds();
+    ULONGLONG lastTime = startTime;
+    ULONGLONG busyTime = 0;
+    BOOL running = TRUE;
+    
+    snapshot->stageCount = stageCount;
+    while (running) {
+        running = WaitForSingleObject(shutdownEvent, interval) == WAIT_TIMEOUT;
+        ULONGLONG now = GetMonotonicMicroseconds();
+        double elapsed = (now - lastTime) / 1000.0;
+        lastTime = now;
+        
+        for (DWORD i = 0; i < stageCount; i++) {
+            StageMetrics* stage = &snapshot->stages[i];
+            DWORD* last = lastBuckets + i * LATENCY_BUCKET_COUNT;
+            
+            stage->queueDepth = ReadCounter(&stageQueues[i].count);
+            stage->activeChannels = ReadCounter(&stageQueues[i].activeChannels);
+            stage->inFlight = (DWORD)globalStats[i].inFlight;
+            stage->totalRequests = ReadCounter(&globalStats[i].totalRequests);
+            stage->droppedRequests = ReadCounter(&globalStats[i].droppedRequests);
+            
+            ReadLatencyWindow(&globalStats[i].sojourn, last, window);
+            stage->completedRequests += (DWORD)window->count;
+            stage->throughput = elapsed > 0 ? window->count * 1000.0 / elapsed : 0;
+            stage->meanLatency = window->count ? (double)window->sum / window->count / 1000.0 : 0;
+            stage->p50Latency = GetLatencyPercentile(window, 50) / 1000.0;
+            stage->p95Latency = GetLatencyPercentile(window, 95) / 1000.0;
+            stage->p99Latency = GetLatencyPercentile(window, 99) / 1000.0;
+            
+            DWORD stageBusy = ReadCounter(&globalStats[i].busyTime);
+            double stageUtilization = elapsed > 0 && stage->activeChannels ?
+                (stageBusy - lastStageBusyTime[i]) / (elapsed * stage->activeChannels) : 0;
+            stage->utilization = stageUtilization < 1.0 ? stageUtilization : 1.0;
+            lastStageBusyTime[i] = stageBusy;
+            
+            stage->channelCount = globalParams.maxChannels[i] < METRICS_MAX_CHANNELS ?
+                globalParams.maxChannels[i] : METRICS_MAX_CHANNELS;
+            for (DWORD j = 0; j < stage->channelCount; j++) {
+                ChannelMetrics* channel = &stage->channels[j];
+                DWORD slot = i * METRICS_MAX_CHANNELS + j;
+                ChannelStats* channelStats = &globalStats[i].channelStats[j];
+                DWORD busy = ReadCounter(&channelStats->totalProcessingTime);
+                DWORD stolen = ReadCounter(&channelStats->stolenProcessingTime);
+                double stolenUtilization = elapsed > 0 ? (stolen - lastStolenTime[slot]) / elapsed : 0;
+                double utilization = elapsed > 0 ?
+                    (busy - lastBusyTime[slot]) / elapsed - stolenUtilization : 0;
+                
+                channel->processedRequests = ReadCounter(&channelStats->processedRequests);
+                channel->active = j < stage->activeChannels;
+                channel->inFlight = (DWORD)channelStats->inFlight;
+                
+                ReadLatencyWindow(&channelStats->sojourn, lastChannelBuckets + slot * LATENCY_BUCKET_COUNT,
+                    window);
+                channel->throughput = elapsed > 0 ? window->count * 1000.0 / elapsed : 0;
+                channel->meanLatency = window->count ? (double)window->sum / window->count / 1000.0 : 0;
+                channel->p50Latency = GetLatencyPercentile(window, 50) / 1000.0;
+                channel->p95Latency = GetLatencyPercentile(window, 95) / 1000.0;
+                channel->p99Latency = GetLatencyPercentile(window, 99) / 1000.0;
+                channel->utilization = utilization < 1.0 ? (utilization > 0 ? utilization : 0) : 1.0;
+                channel->stolenUtilization = stolenUtilization < 1.0 ? stolenUtilization : 1.0;
+                lastBusyTime[slot] = busy;
+                lastStolenTime[slot] = stolen;
+            }
+        }
+        
+        snapshot->running = running;
+        snapshot->sampleInterval = interval;
+        snapshot->sampleCount++;
+        snapshot->elapsedTime = (now - startTime) / 1000.0;
+        PublishMetrics(shared, snapshot);
+        
+        // Накладные расходы - доля времени одного ядра, занятая снятием и
+        // публикацией снимков (по часам, поэтому оценка сверху)
+        ULONGLONG finished = GetMonotonicMicroseconds();
+        busyTime += finished - now;
+        snapshot->samplerOverhead = finished > startTime ?
+            (double)busyTime / (finished - startTime) : 0;
+        if (snapshot->samplerOverhead > METRICS_OVERHEAD_BUDGET && interval < 60000) {
+            interval *= 2;
+        }
+    }
+    
+    // Итоговая оценка накладных расходов, в том числе последнего снимка
+    PublishMetrics(shared, snapshot);
+    
+    HeapFree(GetProcessHeap(), 0, snapshot);
+    HeapFree(GetProcessHeap(), 0, window);
+    HeapFree(GetProcessHeap(), 0, lastBuckets);
+    HeapFree(GetProcessHeap(), 0, lastChannelBuckets);
+    HeapFree(GetProcessHeap(), 0, lastBusyTime);
+    HeapFree(GetProcessHeap(), 0, lastStolenTime);
+    HeapFree(GetProcessHeap(), 0, lastStageBusyTime);
     return 0;
 }
 
+// Средняя интенсивность, которую задаёт процесс поступления, заявок в секунду
+double GetOfferedRate() {
+    switch (globalParams.arrivalProcess) {
+    case ARRIVAL_MMPP:
+        return (globalParams.arrivalRate * globalParams.burstInterval +
+            globalParams.burstRate * globalParams.burstDuration) /
+            (globalParams.burstInterval + globalParams.burstDuration);
+    case ARRIVAL_TRACE: {
+        DWORD count = 0;
+        while (count < traceLength && traceEntries[count].offset < globalParams.simulationTime) {
+            count++;
+        }
+        return globalParams.simulationTime ? count * 1000.0 / globalParams.simulationTime : 0;
+    }
+    default:
+        return globalParams.arrivalRate;
+    }
+}
+
 // Функция вывода статистики
 void PrintStatistics() {
     printf("\nSystem Statistics:\n");
     for (DWORD i = 0; i < globalParams.stageCount; i++) {
-        printf("\nStage %d:\n", i + 1);
+        printf("\nStage %d (%s):\n", i + 1, GetDisciplineName(globalParams.disciplines[i]));
         printf("Total Requests: %d\n", globalStats[i].totalRequests);
         printf("Dropped Requests: %d\n", globalStats[i].droppedRequests);
+        PrintLatency("Sojourn Time", &globalStats[i].sojourn);
+        printf("Active Channels: %d (min %d, max %d, average %.2f)\n",
+            stageQueues[i].activeChannels, globalParams.minChannels[i], globalParams.maxChannels[i],
+            globalParams.simulationTime ? globalStats[i].activeChannelTime / globalParams.simulationTime : 0);
+        printf("Scale Ups: %d, Scale Downs: %d\n", globalStats[i].scaleUps, globalStats[i].scaleDowns);
         
-        for (DWORD j = 0; j < globalParams.channelsPerStage[i]; j++) {
+        for (DWORD j = 0; j < globalParams.maxChannels[i]; j++) {
             printf("Channel %d:\n", j + 1);
             printf("  Processed Requests: %d\n", 
                 globalStats[i].channelStats[j].processedRequests);
+            printf("  Stolen Requests: %d\n",
+                globalStats[i].channelStats[j].stolenRequests);
             printf("  Average Processing Time: %.2f ms\n",
                 globalStats[i].channelStats[j].processedRequests ?
                 (float)globalStats[i].channelStats[j].totalProcessingTime / 
                 globalStats[i].channelStats[j].processedRequests : 0);
-            printf("  Idle Time: %d ms\n", globalStats[i].channelStats[j].idleTime);
+            printf("  Idle Time: %.3f ms\n",
+                globalStats[i].channelStats[j].idleTime / 1000.0);
         }
     }
+    
+    ULONGLONG emitted = 0;
+    ULONGLONG totalLag = 0;
+    ULONGLONG maxLag = 0;
+    for (DWORD i = 0; i < globalParams.generatorCount; i++) {
+        emitted += generators[i].emittedRequests;
+        totalLag += generators[i].totalLag;
+        if (generators[i].maxLag > maxLag) {
+            maxLag = generators[i].maxLag;
+        }
+    }
+    printf("\nArrivals: %s, %d generators, %.2f req/s offered, %.2f req/s emitted\n",
+        GetArrivalProcessName(globalParams.arrivalProcess), globalParams.generatorCount,
+        GetOfferedRate(),
+        globalParams.simulationTime ? emitted * 1000.0 / globalParams.simulationTime : 0);
+    printf("Service: %s\n", GetServiceDistributionName(globalParams.serviceDistribution));
+    printf("Generator Lag: mean %.1f us, max %.1f us\n",
+        emitted ? (double)totalLag / emitted : 0, (double)maxLag);
+    
+    printf("\nCompleted Requests: %llu\n", systemSojourn.count);
+    printf("Missed Deadlines: %d\n", globalStats[globalParams.stageCount - 1].missedDeadlines);
+    PrintLatency("End-to-End Sojourn Time", &systemSojourn);
+    
+    printf("\nScaling Decisions: %d\n", scalingLogSize);
+    for (DWORD i = 0; i < scalingLogSize; i++) {
+        printf("  [%.1f s] Stage %d: %d -> %d channels (depth %d, arrivals %.2f/s, utilization %.0f%%)\n",
+            scalingLog[i].time / 1000.0, scalingLog[i].stageId + 1, scalingLog[i].fromChannels,
+            scalingLog[i].toChannels, scalingLog[i].queueDepth, scalingLog[i].arrivalRate,
+            scalingLog[i].utilization * 100);
+    }
+    
+    if (metricsView) {
+        printf("\nLive Metrics: %s, %llu samples, final interval %d ms, sampler overhead %.4f%%\n",
+            metricsName, metricsView->sampleCount, metricsView->sampleInterval,
+            metricsView->samplerOverhead * 100);
+    }
 }
 
-int main() {
-    // Инициализация параметров системы
-    globalParams.stageCount = 3;
-    globalParams.channelsPerStage = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-        sizeof(DWORD) * globalParams.stageCount);
-    globalParams.bufferSizes = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-        sizeof(DWORD) * globalParams.stageCount);
-    
-    for (DWORD i = 0; i < globalParams.stageCount; i++) {
-        globalParams.channelsPerStage[i] = 2;  
-        globalParams.bufferSizes[i] = 5;       // Размер буфера - 5 заявок
+BOOL ParseDiscipline(const char* name, QueueDiscipline* discipline) {
+    const QueueDiscipline disciplines[] = {
+        DISCIPLINE_FIFO, DISCIPLINE_SJF, DISCIPLINE_EDF, DISCIPLINE_PRIORITY
+    };
+    for (DWORD i = 0; i < sizeof(disciplines) / sizeof(disciplines[0]); i++) {
+        if (_stricmp(name, GetDisciplineName(disciplines[i])) == 0) {
+            *discipline = disciplines[i];
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+BOOL ParseArrivalProcess(const char* name, ArrivalProcess* process) {
+    const ArrivalProcess processes[] = {
+        ARRIVAL_FIXED, ARRIVAL_POISSON, ARRIVAL_MMPP, ARRIVAL_TRACE
+    };
+    for (DWORD i = 0; i < sizeof(processes) / sizeof(processes[0]); i++) {
+        if (_stricmp(name, GetArrivalProcessName(processes[i])) == 0) {
+            *process = processes[i];
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+BOOL ParseServiceDistribution(const char* name, ServiceDistribution* distribution) {
+    const ServiceDistribution distributions[] = {
+        SERVICE_UNIFORM, SERVICE_EXPONENTIAL, SERVICE_LOGNORMAL, SERVICE_EMPIRICAL
+    };
+    for (DWORD i = 0; i < sizeof(distributions) / sizeof(distributions[0]); i++) {
+        if (_stricmp(name, GetServiceDistributionName(distributions[i])) == 0) {
+            *distribution = distributions[i];
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Трасса поступлений: по строке на заявку "момент_мс [время_обработки_мс]",
+// моменты отсчитываются от начала симуляции и не убывают
+BOOL LoadTrace(const char* path) {
+    FILE* file = NULL;
+    char line[128];
+    DWORD capacity = 0;
+
+    if (fopen_s(&file, path, "r") != 0 || !file) {
+        printf("Failed to open trace file: %s\n", path);
+        return FALSE;
     }
+    while (fgets(line, sizeof(line), file)) {
+        char* end;
+        double offset = strtod(line, &end);
+        if (end == line) continue;
+
+        if (traceLength == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            traceEntries = (TraceEntry*)(traceEntries ?
+                HeapReAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, traceEntries, sizeof(TraceEntry) * capacity) :
+                HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(TraceEntry) * capacity));
+        }
+        traceEntries[traceLength].offset = offset;
+        traceEntries[traceLength].processingTime = strtoul(end, NULL, 10);
+        traceLength++;
+    }
+    fclose(file);
+    return TRUE;
+}
+
+// Эмпирическое распределение обработки: по значению (мс) на строку
+BOOL LoadServiceSamples(const char* path) {
+    FILE* file = NULL;
+    char line[64];
+    DWORD capacity = 0;
+
+    if (fopen_s(&file, path, "r") != 0 || !file) {
+        printf("Failed to open service samples file: %s\n", path);
+        return FALSE;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        char* end;
+        DWORD value = strtoul(line, &end, 10);
+        if (end == line) continue;
+
+        if (serviceSampleCount == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            serviceSamples = (DWORD*)(serviceSamples ?
+                HeapReAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, serviceSamples, sizeof(DWORD) * capacity) :
+                HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DWORD) * capacity));
+        }
+        serviceSamples[serviceSampleCount++] = value;
+    }
+    fclose(file);
+    return TRUE;
+}
+
+BOOL LoadWorkload() {
+    if (globalParams.arrivalProcess == ARRIVAL_TRACE && !LoadTrace(globalParams.traceFile)) {
+        return FALSE;
+    }
+    if (globalParams.serviceDistribution == SERVICE_EMPIRICAL &&
+        !LoadServiceSamples(globalParams.serviceSamplesFile)) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void FreeWorkload() {
+    if (traceEntries) {
+        HeapFree(GetProcessHeap(), 0, traceEntries);
+    }
+    if (serviceSamples) {
+        HeapFree(GetProcessHeap(), 0, serviceSamples);
+    }
+}
+
+// Выделение массивов параметров для stageCount ступеней со значениями по умолчанию
+void SetDefaultParameters(SystemParameters* params, DWORD stageCount) {
+    params->stageCount = stageCount;
+    params->channelsPerStage = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    params->bufferSizes = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    params->disciplines = (QueueDiscipline*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(QueueDiscipline) * stageCount);
+    params->minChannels = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    params->maxChannels = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * stageCount);
+    params->channelBudget = 0;
     
-    globalParams.requestGenerationRate = 1000;  // 1 заявка в секунду
-    globalParams.minProcessingTime = 500;       // Минимальное время обработки
-    globalParams.maxProcessingTime = 2000;      // Максимальное время обработки
-    globalParams.simulationTime = 30000;        // 30 секунд симуляции
+    for (DWORD i = 0; i < stageCount; i++) {
+        params->channelsPerStage[i] = 2;  
+        params->minChannels[i] = 1;
+        params->maxChannels[i] = 4;
+        params->channelBudget += params->channelsPerStage[i];
+        params->bufferSizes[i] = 5;       // Размер буфера - 5 заявок
+        params->disciplines[i] = DISCIPLINE_FIFO;
+    }
     
+    params->requestGenerationRate = 1000;  // 1 заявка в секунду
+    params->minProcessingTime = 500;       // Минимальное время обработки
+    params->maxProcessingTime = 2000;      // Максимальное время обработки
+    params->simulationTime = 30000;        // 30 секунд симуляции
+    params->minDeadline = 3000;            // Относительный срок заявки
+    params->maxDeadline = 10000;
+    params->agingInterval = 2000;          // Повышение класса каждые 2 с ожидания
+    params->scalingInterval = 1000;        // Период контроллера масштабирования
+    params->workStealing = TRUE;
+    params->arrivalProcess = ARRIVAL_FIXED;
+    params->arrivalRate = 1000.0 / params->requestGenerationRate;
+    params->burstRate = 5 * params->arrivalRate;
+    params->burstDuration = 2000;
+    params->burstInterval = 10000;
+    params->generatorCount = 1;
+    params->seed = GetTickCount();
+    params->serviceDistribution = SERVICE_UNIFORM;
+    params->meanProcessingTime = (params->minProcessingTime + params->maxProcessingTime) / 2;
+    params->processingTimeSigma = 0.5;
+    params->traceFile[0] = '\0';
+    params->serviceSamplesFile[0] = '\0';
+    params->metricsInterval = 500;         // Период снимков живых метрик
+}
+
+void FreeParameters(SystemParameters* params) {
+    HeapFree(GetProcessHeap(), 0, params->channelsPerStage);
+    HeapFree(GetProcessHeap(), 0, params->bufferSizes);
+    HeapFree(GetProcessHeap(), 0, params->disciplines);
+    HeapFree(GetProcessHeap(), 0, params->minChannels);
+    HeapFree(GetProcessHeap(), 0, params->maxChannels);
+}
+
+// Разбор списка "5,10,20". Возвращает число прочитанных значений.
+DWORD ParseList(const char* text, DWORD* values, DWORD maxValues) {
+    DWORD count = 0;
+    char* end;
+
+    while (*text && count < maxValues) {
+        values[count++] = strtoul(text, &end, 10);
+        if (end == text) {
+            return count - 1;
+        }
+        text = end;
+        while (*text == ',' || *text == ' ') text++;
+    }
+    return count;
+}
+
+// Разбор списка дробных значений "0.5,2,1000"
+DWORD ParseDoubleList(const char* text, double* values, DWORD maxValues) {
+    DWORD count = 0;
+    char* end;
+
+    while (*text && count < maxValues) {
+        values[count++] = strtod(text, &end);
+        if (end == text) {
+            return count - 1;
+        }
+        text = end;
+        while (*text == ',' || *text == ' ') text++;
+    }
+    return count;
+}
+
+void FormatList(const DWORD* values, DWORD count, char* buffer, DWORD bufferSize) {
+    DWORD length = 0;
+
+    buffer[0] = '\0';
+    for (DWORD i = 0; i < count && length < bufferSize; i++) {
+        length += sprintf_s(buffer + length, bufferSize - length, i ? ",%lu" : "%lu", values[i]);
+    }
+}
+
+// Значения по ступеням: если в списке меньше значений, чем ступеней,
+// последнее повторяется. Отсутствующий ключ оставляет values без изменений.
+void ReadStageList(const char* path, const char* section, const char* key,
+    DWORD* values, DWORD stageCount) {
+    char text[256];
+    DWORD count;
+
+    GetPrivateProfileStringA(section, key, "", text, sizeof(text), path);
+    count = ParseList(text, values, stageCount);
+    for (DWORD i = count; count > 0 && i < stageCount; i++) {
+        values[i] = values[count - 1];
+    }
+}
+
+void WriteProfileNumber(const char* path, const char* section, const char* key, DWORD value) {
+    char text[32];
+    sprintf_s(text, sizeof(text), "%lu", value);
+    WritePrivateProfileStringA(section, key, text, path);
+}
+
+void WriteProfileDouble(const char* path, const char* section, const char* key, double value) {
+    char text[64];
+    sprintf_s(text, sizeof(text), "%.6f", value);
+    WritePrivateProfileStringA(section, key, text, path);
+}
+
+double ReadProfileDouble(const char* path, const char* section, const char* key, double defaultValue) {
+    char text[64];
+    GetPrivateProfileStringA(section, key, "", text, sizeof(text), path);
+    return text[0] ? atof(text) : defaultValue;
+}
+
+// Загрузка сценария из секции [scenario] INI-файла поверх значений по умолчанию
+BOOL LoadScenario(const char* path, SystemParameters* params) {
+    char text[256];
+    char* context = NULL;
+    DWORD stageCount = GetPrivateProfileIntA("scenario", "stageCount", 3, path);
+
+    if (GetFileAttributesA(path) == INVALID_FILE_ATTRIBUTES) {
+        printf("Scenario file not found: %s\n", path);
+        return FALSE;
+    }
+    if (stageCount == 0) {
+        printf("Invalid stage count in %s\n", path);
+        return FALSE;
+    }
+
+    SetDefaultParameters(params, stageCount);
+    ReadStageList(path, "scenario", "channelsPerStage", params->channelsPerStage, stageCount);
+    ReadStageList(path, "scenario", "minChannels", params->minChannels, stageCount);
+    ReadStageList(path, "scenario", "maxChannels", params->maxChannels, stageCount);
+    ReadStageList(path, "scenario", "bufferSizes", params->bufferSizes, stageCount);
+
+    GetPrivateProfileStringA("scenario", "disciplines", "", text, sizeof(text), path);
+    char* token = strtok_s(text, ", ", &context);
+    for (DWORD i = 0; i < stageCount; i++) {
+        if (token) {
+            if (!ParseDiscipline(token, &params->disciplines[i])) {
+                printf("Unknown discipline: %s\n", token);
+                FreeParameters(params);
+                return FALSE;
+            }
+            token = strtok_s(NULL, ", ", &context);
+        } else if (i > 0) {
+            params->disciplines[i] = params->disciplines[i - 1];
+        }
+    }
+
+    params->channelBudget = 0;
+    for (DWORD i = 0; i < stageCount; i++) {
+        // Ступень без каналов молча теряет все дошедшие до неё заявки
+        if (params->channelsPerStage[i] == 0) {
+            printf("Stage %lu has no channels in %s\n", i + 1, path);
+            FreeParameters(params);
+            return FALSE;
+        }
+        if (params->maxChannels[i] < params->channelsPerStage[i]) {
+            params->maxChannels[i] = params->channelsPerStage[i];
+        }
+        if (params->minChannels[i] > params->channelsPerStage[i]) {
+            params->minChannels[i] = params->channelsPerStage[i];
+        }
+        if (params->bufferSizes[i] == 0) {
+            params->bufferSizes[i] = 1;
+        }
+        params->channelBudget += params->channelsPerStage[i];
+    }
+    DWORD initialChannels = params->channelBudget;
+    params->channelBudget = GetPrivateProfileIntA("scenario", "channelBudget",
+        params->channelBudget, path);
+    if (params->channelBudget < initialChannels) {
+        // Контроллер только перераспределяет каналы и не опускает их
+        // сумму ниже начальной, поэтому бюджет не может быть меньше её
+        printf("channelBudget raised to %lu, the sum of channelsPerStage\n", initialChannels);
+        params->channelBudget = initialChannels;
+    }
+
+    params->requestGenerationRate = GetPrivateProfileIntA("scenario", "requestGenerationRate",
+        params->requestGenerationRate, path);
+    params->minProcessingTime = GetPrivateProfileIntA("scenario", "minProcessingTime",
+        params->minProcessingTime, path);
+    params->maxProcessingTime = GetPrivateProfileIntA("scenario", "maxProcessingTime",
+        params->maxProcessingTime, path);
+    params->simulationTime = GetPrivateProfileIntA("scenario", "simulationTime",
+        params->simulationTime, path);
+    params->minDeadline = GetPrivateProfileIntA("scenario", "minDeadline", params->minDeadline, path);
+    params->maxDeadline = GetPrivateProfileIntA("scenario", "maxDeadline", params->maxDeadline, path);
+    params->agingInterval = GetPrivateProfileIntA("scenario", "agingInterval",
+        params->agingInterval, path);
+    params->scalingInterval = GetPrivateProfileIntA("scenario", "scalingInterval",
+        params->scalingInterval, path);
+    params->workStealing = GetPrivateProfileIntA("scenario", "workStealing",
+        params->workStealing, path) != 0;
+    params->metricsInterval = GetPrivateProfileIntA("scenario", "metricsInterval",
+        params->metricsInterval, path);
+
+    GetPrivateProfileStringA("scenario", "arrivalProcess", "", text, sizeof(text), path);
+    if (text[0] && !ParseArrivalProcess(text, &params->arrivalProcess)) {
+        printf("Unknown arrival process: %s\n", text);
+        FreeParameters(params);
+        return FALSE;
+    }
+    GetPrivateProfileStringA("scenario", "serviceDistribution", "", text, sizeof(text), path);
+    if (text[0] && !ParseServiceDistribution(text, &params->serviceDistribution)) {
+        printf("Unknown service distribution: %s\n", text);
+        FreeParameters(params);
+        return FALSE;
+    }
+    params->arrivalRate = ReadProfileDouble(path, "scenario", "arrivalRate",
+        params->requestGenerationRate ? 1000.0 / params->requestGenerationRate : 0);
+    params->burstRate = ReadProfileDouble(path, "scenario", "burstRate", 5 * params->arrivalRate);
+    params->burstDuration = GetPrivateProfileIntA("scenario", "burstDuration",
+        params->burstDuration, path);
+    params->burstInterval = GetPrivateProfileIntA("scenario", "burstInterval",
+        params->burstInterval, path);
+    params->generatorCount = GetPrivateProfileIntA("scenario", "generatorCount",
+        params->generatorCount, path);
+    GetPrivateProfileStringA("scenario", "seed", "", text, sizeof(text), path);
+    if (text[0]) {
+        params->seed = strtoull(text, NULL, 10);
+    }
+    params->meanProcessingTime = GetPrivateProfileIntA("scenario", "meanProcessingTime",
+        (params->minProcessingTime + params->maxProcessingTime) / 2, path);
+    params->processingTimeSigma = ReadProfileDouble(path, "scenario", "processingTimeSigma",
+        params->processingTimeSigma);
+    GetPrivateProfileStringA("scenario", "traceFile", "", text, sizeof(text), path);
+    if (text[0]) {
+        GetFullPathNameA(text, MAX_PATH, params->traceFile, NULL);
+    }
+    GetPrivateProfileStringA("scenario", "serviceSamplesFile", "", text, sizeof(text), path);
+    if (text[0]) {
+        GetFullPathNameA(text, MAX_PATH, params->serviceSamplesFile, NULL);
+    }
+
+    if (params->maxProcessingTime < params->minProcessingTime) {
+        params->maxProcessingTime = params->minProcessingTime;
+    }
+    if (params->maxDeadline < params->minDeadline) {
+        params->maxDeadline = params->minDeadline;
+    }
+    if (params->scalingInterval == 0) {
+        params->scalingInterval = 1000;
+    }
+    if (params->arrivalProcess != ARRIVAL_TRACE &&
+        (params->arrivalRate <= 0 || (params->arrivalProcess == ARRIVAL_MMPP && params->burstRate <= 0))) {
+        printf("Arrival rate must be positive\n");
+        FreeParameters(params);
+        return FALSE;
+    }
+    if (params->burstDuration == 0) params->burstDuration = 1;
+    if (params->burstInterval == 0) params->burstInterval = 1;
+    if (params->generatorCount == 0) params->generatorCount = 1;
+    if (params->generatorCount > MAXIMUM_WAIT_OBJECTS) {
+        // Потоки генераторов ожидаются одним WaitForMultipleObjects
+        printf("generatorCount must not exceed %d\n", MAXIMUM_WAIT_OBJECTS);
+        FreeParameters(params);
+        return FALSE;
+    }
+    if (params->arrivalProcess != ARRIVAL_TRACE &&
+        (params->arrivalRate > MAX_ARRIVAL_RATE * params->generatorCount ||
+        (params->arrivalProcess == ARRIVAL_MMPP && params->burstRate > MAX_ARRIVAL_RATE * params->generatorCount))) {
+        // Расписание отсчитывается в микросекундах монотонных часов
+        printf("Arrival rate must not exceed %.0f req/s per generator\n", MAX_ARRIVAL_RATE);
+        FreeParameters(params);
+        return FALSE;
+    }
+    if (params->meanProcessingTime == 0) params->meanProcessingTime = 1;
+    return TRUE;
+}
+
+BOOL SaveScenario(const char* path, const SystemParameters* params) {
+    char text[256];
+    DWORD length = 0;
+
+    WriteProfileNumber(path, "scenario", "stageCount", params->stageCount);
+    FormatList(params->channelsPerStage, params->stageCount, text, sizeof(text));
+    WritePrivateProfileStringA("scenario", "channelsPerStage", text, path);
+    FormatList(params->minChannels, params->stageCount, text, sizeof(text));
+    WritePrivateProfileStringA("scenario", "minChannels", text, path);
+    FormatList(params->maxChannels, params->stageCount, text, sizeof(text));
+    WritePrivateProfileStringA("scenario", "maxChannels", text, path);
+    FormatList(params->bufferSizes, params->stageCount, text, sizeof(text));
+    WritePrivateProfileStringA("scenario", "bufferSizes", text, path);
+
+    text[0] = '\0';
+    for (DWORD i = 0; i < params->stageCount; i++) {
+        length += sprintf_s(text + length, sizeof(text) - length, i ? ",%s" : "%s",
+            GetDisciplineName(params->disciplines[i]));
+    }
+    WritePrivateProfileStringA("scenario", "disciplines", text, path);
+
+    WriteProfileNumber(path, "scenario", "channelBudget", params->channelBudget);
+    WriteProfileNumber(path, "scenario", "requestGenerationRate", params->requestGenerationRate);
+    WriteProfileNumber(path, "scenario", "minProcessingTime", params->minProcessingTime);
+    WriteProfileNumber(path, "scenario", "maxProcessingTime", params->maxProcessingTime);
+    WriteProfileNumber(path, "scenario", "simulationTime", params->simulationTime);
+    WriteProfileNumber(path, "scenario", "minDeadline", params->minDeadline);
+    WriteProfileNumber(path, "scenario", "maxDeadline", params->maxDeadline);
+    WriteProfileNumber(path, "scenario", "agingInterval", params->agingInterval);
+    WriteProfileNumber(path, "scenario", "scalingInterval", params->scalingInterval);
+    WriteProfileNumber(path, "scenario", "workStealing", params->workStealing);
+    WriteProfileNumber(path, "scenario", "metricsInterval", params->metricsInterval);
+    WritePrivateProfileStringA("scenario", "arrivalProcess",
+        GetArrivalProcessName(params->arrivalProcess), path);
+    WriteProfileDouble(path, "scenario", "arrivalRate", params->arrivalRate);
+    WriteProfileDouble(path, "scenario", "burstRate", params->burstRate);
+    WriteProfileNumber(path, "scenario", "burstDuration", params->burstDuration);
+    WriteProfileNumber(path, "scenario", "burstInterval", params->burstInterval);
+    WriteProfileNumber(path, "scenario", "generatorCount", params->generatorCount);
+    sprintf_s(text, sizeof(text), "%llu", params->seed);
+    WritePrivateProfileStringA("scenario", "seed", text, path);
+    WritePrivateProfileStringA("scenario", "serviceDistribution",
+        GetServiceDistributionName(params->serviceDistribution), path);
+    WriteProfileNumber(path, "scenario", "meanProcessingTime", params->meanProcessingTime);
+    WriteProfileDouble(path, "scenario", "processingTimeSigma", params->processingTimeSigma);
+    WritePrivateProfileStringA("scenario", "traceFile", params->traceFile, path);
+    WritePrivateProfileStringA("scenario", "serviceSamplesFile", params->serviceSamplesFile, path);
+    return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
+}
+
+// Итоговые показатели прогона; вызывается после остановки всех потоков
+void CollectResults(ScenarioResult* result) {
+    double busyTime = 0;
+    double activeChannelTime = 0;
+
+    result->generated = globalStats[0].totalRequests + globalStats[0].droppedRequests;
+    result->dropped = 0;
+    for (DWORD i = 0; i < globalParams.stageCount; i++) {
+        result->dropped += globalStats[i].droppedRequests;
+        activeChannelTime += globalStats[i].activeChannelTime;
+        busyTime += globalStats[i].busyTime;
+    }
+    result->completed = (DWORD)systemSojourn.count;
+    result->throughput = globalParams.simulationTime ?
+        result->completed * 1000.0 / globalParams.simulationTime : 0;
+    result->dropRate = result->generated ? (double)result->dropped / result->generated : 0;
+    result->utilization = activeChannelTime > 0 ? busyTime / activeChannelTime : 0;
+    result->meanLatency = systemSojourn.count ?
+        (double)systemSojourn.sum / systemSojourn.count / 1000.0 : 0;
+    result->p50Latency = GetLatencyPercentile(&systemSojourn, 50) / 1000.0;
+    result->p95Latency = GetLatencyPercentile(&systemSojourn, 95) / 1000.0;
+    result->p99Latency = GetLatencyPercentile(&systemSojourn, 99) / 1000.0;
+}
+
+BOOL SaveResults(const char* path, const ScenarioResult* result) {
+    WriteProfileNumber(path, "result", "generated", result->generated);
+    WriteProfileNumber(path, "result", "completed", result->completed);
+    WriteProfileNumber(path, "result", "dropped", result->dropped);
+    WriteProfileDouble(path, "result", "throughput", result->throughput);
+    WriteProfileDouble(path, "result", "dropRate", result->dropRate);
+    WriteProfileDouble(path, "result", "utilization", result->utilization);
+    WriteProfileDouble(path, "result", "meanLatency", result->meanLatency);
+    WriteProfileDouble(path, "result", "p50Latency", result->p50Latency);
+    WriteProfileDouble(path, "result", "p95Latency", result->p95Latency);
+    WriteProfileDouble(path, "result", "p99Latency", result->p99Latency);
+    return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
+}
+
+BOOL LoadResults(const char* path, ScenarioResult* result) {
+    if (GetFileAttributesA(path) == INVALID_FILE_ATTRIBUTES) {
+        return FALSE;
+    }
+    result->generated = GetPrivateProfileIntA("result", "generated", 0, path);
+    result->completed = GetPrivateProfileIntA("result", "completed", 0, path);
+    result->dropped = GetPrivateProfileIntA("result", "dropped", 0, path);
+    result->throughput = ReadProfileDouble(path, "result", "throughput", 0);
+    result->dropRate = ReadProfileDouble(path, "result", "dropRate", 1);
+    result->utilization = ReadProfileDouble(path, "result", "utilization", 0);
+    result->meanLatency = ReadProfileDouble(path, "result", "meanLatency", 0);
+    result->p50Latency = ReadProfileDouble(path, "result", "p50Latency", 0);
+    result->p95Latency = ReadProfileDouble(path, "result", "p95Latency", 0);
+    result->p99Latency = ReadProfileDouble(path, "result", "p99Latency", 0);
+    return TRUE;
+}
+
+// Один прогон системы с параметрами globalParams
+void RunSimulation(ScenarioResult* result) {
     // Инициализация критической секции
     InitializeCriticalSection(&statsCriticalSection);
     
@@ -152,48 +1610,36 @@ int main() {
     globalStats = (StageStats*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
         sizeof(StageStats) * globalParams.stageCount);
     
-    // Инициализация семафоров, мьютексов и буферов для каждой ступени
-    HANDLE* stageSemaphores = (HANDLE*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-        sizeof(HANDLE) * globalParams.stageCount);
-    HANDLE* stageMutexes = (HANDLE*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-        sizeof(HANDLE) * globalParams.stageCount);
-    Request*** stageBuffers = (Request***)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-        sizeof(Request**) * globalParams.stageCount);
-    DWORD** currentBufferSizes = (DWORD**)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-        sizeof(DWORD*) * globalParams.stageCount);
-    
-    // Создание потоков для каждого канала
+    // Событие остановки и буферы для каждой ступени
+    shutdownEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    stageQueues = (StageQueue*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(StageQueue) * globalParams.stageCount);
+    for (DWORD i = 0; i < globalParams.stageCount; i++) {
+        InitializeStageQueue(&stageQueues[i], globalParams.bufferSizes[i],
+            globalParams.disciplines[i], globalParams.agingInterval);
+        stageQueues[i].activeChannels = globalParams.channelsPerStage[i];
+    }
+    
+    // Создание потоков для каждого канала. Потоки создаются до maxChannels,
+    // лишние ждут на parked, пока контроллер не введёт их в работу
     HANDLE** channelThreads = (HANDLE**)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
         sizeof(HANDLE*) * globalParams.stageCount);
     ChannelParams** channelParams = (ChannelParams**)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
         sizeof(ChannelParams*) * globalParams.stageCount);
     
     for (DWORD i = 0; i < globalParams.stageCount; i++) {
-        stageSemaphores[i] = CreateSemaphore(NULL, globalParams.bufferSizes[i],
-            globalParams.bufferSizes[i], NULL);
-        stageMutexes[i] = CreateMutex(NULL, FALSE, NULL);
-        
-        stageBuffers[i] = (Request**)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-            sizeof(Request*) * globalParams.bufferSizes[i]);
-        currentBufferSizes[i] = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-            sizeof(DWORD));
-        
         channelThreads[i] = (HANDLE*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-            sizeof(HANDLE) * globalParams.channelsPerStage[i]);
+            sizeof(HANDLE) * globalParams.maxChannels[i]);
         channelParams[i] = (ChannelParams*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-            sizeof(ChannelParams) * globalParams.channelsPerStage[i]);
+            sizeof(ChannelParams) * globalParams.maxChannels[i]);
         
         globalStats[i].channelStats = (ChannelStats*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-            sizeof(ChannelStats) * globalParams.channelsPerStage[i]);
+            sizeof(ChannelStats) * globalParams.maxChannels[i]);
         
-        for (DWORD j = 0; j < globalParams.channelsPerStage[i]; j++) {
+        for (DWORD j = 0; j < globalParams.maxChannels[i]; j++) {
             channelParams[i][j].stageId = i;
             channelParams[i][j].channelId = j;
-            channelParams[i][j].bufferSemaphore = stageSemaphores[i];
-            channelParams[i][j].bufferMutex = stageMutexes[i];
-            channelParams[i][j].buffer = stageBuffers[i];
-            channelParams[i][j].bufferSize = &globalParams.bufferSizes[i];
-            channelParams[i][j].currentBufferSize = currentBufferSizes[i];
+            channelParams[i][j].queue = &stageQueues[i];
             channelParams[i][j].stats = &globalStats[i];
             channelParams[i][j].params = &globalParams;
             channelParams[i][j].isRunning = &isSystemRunning;
@@ -203,47 +1649,471 @@ int main() {
         }
     }
     
-    // Создание генератора заявок
-    HANDLE generatorThread = CreateThread(NULL, 0, RequestGenerator,
-        &channelParams[0][0], 0, NULL);
+    // Создание генераторов заявок
+    HANDLE* generatorThreads = (HANDLE*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(HANDLE) * globalParams.generatorCount);
+    generators = (GeneratorParams*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(GeneratorParams) * globalParams.generatorCount);
+    for (DWORD i = 0; i < globalParams.generatorCount; i++) {
+        generators[i].generatorId = i;
+        generators[i].queue = &stageQueues[0];
+        generators[i].stats = &globalStats[0];
+        if (i == 0) {
+            SeedRandom(generators[i].random, globalParams.seed);
+        } else {
+            memcpy(generators[i].random, generators[i - 1].random, sizeof(generators[i].random));
+            JumpRandom(generators[i].random);
+        }
+    }
+    // Расписание пачек строится один раз на отрезке после генераторов
+    if (globalParams.arrivalProcess == ARRIVAL_MMPP) {
+        ULONGLONG scheduleRandom[4];
+        memcpy(scheduleRandom, generators[globalParams.generatorCount - 1].random, sizeof(scheduleRandom));
+        JumpRandom(scheduleRandom);
+        BuildBurstSchedule(scheduleRandom);
+    }
+    // Общее начало расписания: смещения трассы и фазы равномерного потока
+    // отсчитываются от одного момента для всех генераторов
+    ULONGLONG generationStart = GetMonotonicMicroseconds();
+    for (DWORD i = 0; i < globalParams.generatorCount; i++) {
+        generators[i].startTime = generationStart;
+        generatorThreads[i] = CreateThread(NULL, 0, RequestGenerator, &generators[i], 0, NULL);
+    }
+    
+    // Создание контроллера масштабирования
+    HANDLE controllerThread = CreateThread(NULL, 0, ScalingController, NULL, 0, NULL);
+    
+    // Живые метрики в именованной разделяемой памяти для QueueMonitor
+    HANDLE metricsMapping = NULL;
+    HANDLE samplerThread = NULL;
+    if (globalParams.metricsInterval > 0) {
+        sprintf_s(metricsName, sizeof(metricsName), METRICS_MAPPING_NAME, GetCurrentProcessId());
+        metricsMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+            0, sizeof(MetricsSnapshot), metricsName);
+        if (metricsMapping) {
+            metricsView = (MetricsSnapshot*)MapViewOfFile(metricsMapping, FILE_MAP_ALL_ACCESS,
+                0, 0, sizeof(MetricsSnapshot));
+        }
+        if (metricsView) {
+            samplerThread = CreateThread(NULL, 0, MetricsSampler, metricsView, 0, NULL);
+            printf("Live metrics: QueueMonitor %lu\n", GetCurrentProcessId());
+        } else {
+            printf("Live metrics unavailable (error %lu)\n", GetLastError());
+        }
+    }
     
     // Ожидание завершения симуляции
     Sleep(globalParams.simulationTime);
-    isSystemRunning = FALSE;
+    SignalShutdown();
     
     // Ожидание завершения всех потоков
-    WaitForSingleObject(generatorThread, INFINITE);
+    WaitForMultipleObjects(globalParams.generatorCount, generatorThreads, TRUE, INFINITE);
+    WaitForSingleObject(controllerThread, INFINITE);
+    if (samplerThread) {
+        WaitForSingleObject(samplerThread, INFINITE);
+        CloseHandle(samplerThread);
+    }
+    for (DWORD i = 0; i < globalParams.generatorCount; i++) {
+        CloseHandle(generatorThreads[i]);
+    }
+    CloseHandle(controllerThread);
     for (DWORD i = 0; i < globalParams.stageCount; i++) {
-        for (DWORD j = 0; j < globalParams.channelsPerStage[i]; j++) {
+        for (DWORD j = 0; j < globalParams.maxChannels[i]; j++) {
             WaitForSingleObject(channelThreads[i][j], INFINITE);
             CloseHandle(channelThreads[i][j]);
         }
     }
     
     PrintStatistics();
+    CollectResults(result);
+    
+    if (metricsView) {
+        UnmapViewOfFile(metricsView);
+        metricsView = NULL;
+    }
+    if (metricsMapping) {
+        CloseHandle(metricsMapping);
+    }
     
     DeleteCriticalSection(&statsCriticalSection);
     
     for (DWORD i = 0; i < globalParams.stageCount; i++) {
-        CloseHandle(stageSemaphores[i]);
-        CloseHandle(stageMutexes[i]);
-        
-        HeapFree(GetProcessHeap(), 0, stageBuffers[i]);
-        HeapFree(GetProcessHeap(), 0, currentBufferSizes[i]);
+        DeleteStageQueue(&stageQueues[i]);
         HeapFree(GetProcessHeap(), 0, channelThreads[i]);
         HeapFree(GetProcessHeap(), 0, channelParams[i]);
         HeapFree(GetProcessHeap(), 0, globalStats[i].channelStats);
     }
     
-    HeapFree(GetProcessHeap(), 0, stageSemaphores);
-    HeapFree(GetProcessHeap(), 0, stageMutexes);
-    HeapFree(GetProcessHeap(), 0, stageBuffers);
-    HeapFree(GetProcessHeap(), 0, currentBufferSizes);
+    CloseHandle(shutdownEvent);
+    HeapFree(GetProcessHeap(), 0, stageQueues);
     HeapFree(GetProcessHeap(), 0, channelThreads);
     HeapFree(GetProcessHeap(), 0, channelParams);
     HeapFree(GetProcessHeap(), 0, globalStats);
-    HeapFree(GetProcessHeap(), 0, globalParams.channelsPerStage);
-    HeapFree(GetProcessHeap(), 0, globalParams.bufferSizes);
+    HeapFree(GetProcessHeap(), 0, generatorThreads);
+    HeapFree(GetProcessHeap(), 0, generators);
+    if (scalingLog) {
+        HeapFree(GetProcessHeap(), 0, scalingLog);
+    }
+    if (burstSchedule) {
+        HeapFree(GetProcessHeap(), 0, burstSchedule);
+        burstSchedule = NULL;
+        burstScheduleLength = 0;
+    }
+}
+
+// Запуск точки перебора дочерним процессом: сценарии независимы и
+// используют глобальное состояние, поэтому выполняются в отдельных процессах
+HANDLE StartSweepPoint(const char* scenarioPath, const char* resultPath, HANDLE nullOutput) {
+    char modulePath[MAX_PATH];
+    char commandLine[3 * MAX_PATH + 64];
+    STARTUPINFOA startupInfo;
+    PROCESS_INFORMATION processInfo;
+
+    GetModuleFileNameA(NULL, modulePath, MAX_PATH);
+    sprintf_s(commandLine, sizeof(commandLine), "\"%s\" --scenario \"%s\" --result \"%s\"",
+        modulePath, scenarioPath, resultPath);
+
+    ZeroMemory(&startupInfo, sizeof(startupInfo));
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdInput = nullOutput;
+    startupInfo.hStdOutput = nullOutput;
+    startupInfo.hStdError = nullOutput;
+
+    if (!CreateProcessA(NULL, commandLine, NULL, NULL, TRUE, 0, NULL, NULL,
+        &startupInfo, &processInfo)) {
+        printf("Failed to start scenario. Error: %lu\n", GetLastError());
+        return NULL;
+    }
+    CloseHandle(processInfo.hThread);
+    return processInfo.hProcess;
+}
+
+void WriteSweepCsv(const char* path, const SweepPoint* points, DWORD pointCount, double targetDropRate) {
+    FILE* file = NULL;
+
+    if (fopen_s(&file, path, "w") != 0 || !file) {
+        printf("Failed to write %s\n", path);
+        return;
+    }
+    fprintf(file, "requestGenerationRate,arrivalRate,channelsPerStage,bufferSize,generated,completed,"
+        "dropped,throughput,dropRate,utilization,meanLatency,p50Latency,p95Latency,p99Latency,meetsTarget\n");
+    for (DWORD i = 0; i < pointCount; i++) {
+        const ScenarioResult* r = &points[i].result;
+        fprintf(file, "%lu,%.3f,%lu,%lu,%lu,%lu,%lu,%.3f,%.6f,%.4f,%.2f,%.2f,%.2f,%.2f,%d\n",
+            points[i].requestGenerationRate, points[i].arrivalRate,
+            points[i].channelsPerStage, points[i].bufferSize, r->generated, r->completed, r->dropped,
+            r->throughput, r->dropRate, r->utilization, r->meanLatency, r->p50Latency,
+            r->p95Latency, r->p99Latency, points[i].completed && r->dropRate <= targetDropRate);
+    }
+    fclose(file);
+}
+
+void WriteSweepJson(const char* path, const SweepPoint* points, DWORD pointCount, double targetDropRate) {
+    FILE* file = NULL;
+
+    if (fopen_s(&file, path, "w") != 0 || !file) {
+        printf("Failed to write %s\n", path);
+        return;
+    }
+    fprintf(file, "{\n  \"targetDropRate\": %.6f,\n  \"scenarios\": [\n", targetDropRate);
+    for (DWORD i = 0; i < pointCount; i++) {
+        const ScenarioResult* r = &points[i].result;
+        fprintf(file, "    {\"requestGenerationRate\": %lu, \"arrivalRate\": %.3f, "
+            "\"channelsPerStage\": %lu, \"bufferSize\": %lu, \"succeeded\": %s, "
+            "\"generated\": %lu, \"completed\": %lu, \"dropped\": %lu, \"throughput\": %.3f, \"dropRate\": %.6f, "
+            "\"utilization\": %.4f, \"latency\": {\"mean\": %.2f, \"p50\": %.2f, "
+            "\"p95\": %.2f, \"p99\": %.2f}}%s\n",
+            points[i].requestGenerationRate, points[i].arrivalRate,
+            points[i].channelsPerStage, points[i].bufferSize, points[i].completed ? "true" : "false",
+            r->generated, r->completed, r->dropped, r->throughput, r->dropRate, r->utilization,
+            r->meanLatency, r->p50Latency, r->p95Latency, r->p99Latency,
+            i + 1 < pointCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+// Для каждой интенсивности - наименьшая конфигурация (по числу каналов,
+// затем по размеру буфера), укладывающаяся в целевую долю потерь
+void PrintCapacityPlan(const SweepPoint* points, DWORD pointCount, double targetDropRate) {
+    printf("\nCapacity plan (target drop rate %.2f%%):\n", targetDropRate * 100);
+    for (DWORD i = 0; i < pointCount; i++) {
+        BOOL firstOfRate = TRUE;
+        for (DWORD j = 0; j < i; j++) {
+            if (points[j].arrivalRate == points[i].arrivalRate) {
+                firstOfRate = FALSE;
+                break;
+            }
+        }
+        if (!firstOfRate) continue;
+
+        const SweepPoint* best = NULL;
+        for (DWORD j = i; j < pointCount; j++) {
+            const SweepPoint* point = &points[j];
+            if (point->arrivalRate != points[i].arrivalRate ||
+                !point->completed || point->result.dropRate > targetDropRate) continue;
+            if (!best || point->channelsPerStage < best->channelsPerStage ||
+                (point->channelsPerStage == best->channelsPerStage && point->bufferSize < best->bufferSize)) {
+                best = point;
+            }
+        }
+
+        if (best) {
+            printf("  %.2f req/s: %lu channels per stage, buffer %lu "
+                "(drop %.2f%%, p99 %.2f ms, utilization %.0f%%)\n",
+                points[i].arrivalRate, best->channelsPerStage, best->bufferSize,
+                best->result.dropRate * 100, best->result.p99Latency, best->result.utilization * 100);
+        } else {
+            printf("  %.2f req/s: no configuration meets the target\n", points[i].arrivalRate);
+        }
+    }
+}
+
+// Значения перебора должны быть положительными, как и в [scenario]
+BOOL ValidateSweepList(const char* key, const DWORD* values, DWORD count) {
+    for (DWORD i = 0; i < count; i++) {
+        if (values[i] == 0) {
+            printf("Sweep %s values must be positive\n", key);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Перебор сценариев из секции [sweep]: базовый сценарий берётся из
+// [scenario] того же файла, варьируются интенсивность, число каналов
+// на ступень и размер буфера. Точки выполняются параллельно.
+int RunSweep(const char* path) {
+    SystemParameters base = {0};
+    double rates[64];
+    DWORD intervals[64], channels[64], buffers[64];
+    DWORD rateCount, channelCount, bufferCount;
+    char text[256];
+    char csvPath[MAX_PATH], jsonPath[MAX_PATH], tempPath[MAX_PATH];
+    SYSTEM_INFO systemInfo;
+
+    if (!LoadScenario(path, &base)) {
+        return 1;
+    }
+
+    // Интенсивность перебирается как arrivalRate (заявок в секунду);
+    // список requestGenerationRate (мс между заявками) - прежняя форма того же
+    GetPrivateProfileStringA("sweep", "arrivalRate", "", text, sizeof(text), path);
+    rateCount = ParseDoubleList(text, rates, 64);
+    if (rateCount == 0) {
+        GetPrivateProfileStringA("sweep", "requestGenerationRate", "", text, sizeof(text), path);
+        DWORD intervalCount = ParseList(text, intervals, 64);
+        if (!ValidateSweepList("requestGenerationRate", intervals, intervalCount)) {
+            FreeParameters(&base);
+            return 1;
+        }
+        for (DWORD i = 0; i < intervalCount; i++) {
+            rates[rateCount++] = 1000.0 / intervals[i];
+        }
+    }
+    GetPrivateProfileStringA("sweep", "channelsPerStage", "", text, sizeof(text), path);
+    channelCount = ParseList(text, channels, 64);
+    GetPrivateProfileStringA("sweep", "bufferSizes", "", text, sizeof(text), path);
+    bufferCount = ParseList(text, buffers, 64);
+    for (DWORD i = 0; i < rateCount; i++) {
+        if (rates[i] <= 0 || rates[i] > MAX_ARRIVAL_RATE * base.generatorCount) {
+            printf("Sweep arrivalRate values must be in (0, %.0f]\n", MAX_ARRIVAL_RATE * base.generatorCount);
+            FreeParameters(&base);
+            return 1;
+        }
+    }
+    if (!ValidateSweepList("channelsPerStage", channels, channelCount) ||
+        !ValidateSweepList("bufferSizes", buffers, bufferCount)) {
+        FreeParameters(&base);
+        return 1;
+    }
+    if (rateCount == 0) rates[rateCount++] = base.arrivalRate;
+    if (channelCount == 0) channels[channelCount++] = base.channelsPerStage[0];
+    if (bufferCount == 0) buffers[bufferCount++] = base.bufferSizes[0];
+
+    double targetDropRate = ReadProfileDouble(path, "sweep", "targetDropRate", 0.01);
+    GetPrivateProfileStringA("sweep", "csv", "sweep.csv", csvPath, MAX_PATH, path);
+    GetPrivateProfileStringA("sweep", "json", "sweep.json", jsonPath, MAX_PATH, path);
+    GetSystemInfo(&systemInfo);
+    DWORD parallel = GetPrivateProfileIntA("sweep", "parallel", 0, path);
+    if (parallel == 0) {
+        parallel = systemInfo.dwNumberOfProcessors;
+    }
+    if (parallel > MAXIMUM_WAIT_OBJECTS) {
+        parallel = MAXIMUM_WAIT_OBJECTS;
+    }
+
+    DWORD pointCount = rateCount * channelCount * bufferCount;
+    SweepPoint* points = (SweepPoint*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(SweepPoint) * pointCount);
+    HANDLE* running = (HANDLE*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(HANDLE) * parallel);
+    DWORD* runningPoints = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+        sizeof(DWORD) * parallel);
+
+    SECURITY_ATTRIBUTES inheritable = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    HANDLE nullOutput = CreateFileA("NUL", GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE, &inheritable, OPEN_EXISTING, 0, NULL);
+    GetTempPathA(MAX_PATH, tempPath);
+
+    printf("Sweeping %lu scenarios, %lu in parallel...\n", pointCount, parallel);
+
+    DWORD next = 0;
+    DWORD runningCount = 0;
+    DWORD finished = 0;
+    while (finished < pointCount) {
+        // Заполнение свободных слотов
+        while (runningCount < parallel && next < pointCount) {
+            SweepPoint* point = &points[next];
+            point->arrivalRate = rates[next / (channelCount * bufferCount)];
+            point->requestGenerationRate = (DWORD)(1000.0 / point->arrivalRate + 0.5);
+            point->channelsPerStage = channels[next / bufferCount % channelCount];
+            point->bufferSize = buffers[next % bufferCount];
+            sprintf_s(point->scenarioPath, MAX_PATH, "%sQueueSystem_%lu_%lu.ini",
+                tempPath, GetCurrentProcessId(), next);
+            sprintf_s(point->resultPath, MAX_PATH, "%sQueueSystem_%lu_%lu.res",
+                tempPath, GetCurrentProcessId(), next);
+
+            globalParams = base;
+            globalParams.channelsPerStage = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                sizeof(DWORD) * base.stageCount);
+            globalParams.minChannels = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                sizeof(DWORD) * base.stageCount);
+            globalParams.maxChannels = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                sizeof(DWORD) * base.stageCount);
+            globalParams.bufferSizes = (DWORD*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                sizeof(DWORD) * base.stageCount);
+            globalParams.requestGenerationRate = point->requestGenerationRate;
+            globalParams.arrivalRate = point->arrivalRate;
+            globalParams.burstRate = base.arrivalRate > 0 ?
+                base.burstRate * globalParams.arrivalRate / base.arrivalRate : base.burstRate;
+            globalParams.channelBudget = point->channelsPerStage * base.stageCount;
+            for (DWORD i = 0; i < base.stageCount; i++) {
+                globalParams.channelsPerStage[i] = point->channelsPerStage;
+                globalParams.minChannels[i] = base.minChannels[i] < point->channelsPerStage ?
+                    base.minChannels[i] : point->channelsPerStage;
+                globalParams.maxChannels[i] = base.maxChannels[i] > point->channelsPerStage ?
+                    base.maxChannels[i] : point->channelsPerStage;
+                globalParams.bufferSizes[i] = point->bufferSize;
+            }
+            DeleteFileA(point->scenarioPath);
+            BOOL saved = SaveScenario(point->scenarioPath, &globalParams);
+            HeapFree(GetProcessHeap(), 0, globalParams.channelsPerStage);
+            HeapFree(GetProcessHeap(), 0, globalParams.minChannels);
+            HeapFree(GetProcessHeap(), 0, globalParams.maxChannels);
+            HeapFree(GetProcessHeap(), 0, globalParams.bufferSizes);
+
+            HANDLE process = saved ?
+                StartSweepPoint(point->scenarioPath, point->resultPath, nullOutput) : NULL;
+            if (process) {
+                running[runningCount] = process;
+                runningPoints[runningCount] = next;
+                runningCount++;
+            } else {
+                finished++;
+            }
+            next++;
+        }
+        if (runningCount == 0) continue;
+
+        // Ожидание завершения любого из запущенных сценариев
+        DWORD slot = WaitForMultipleObjects(runningCount, running, FALSE, INFINITE) - WAIT_OBJECT_0;
+        SweepPoint* point = &points[runningPoints[slot]];
+        DWORD exitCode = 1;
+        GetExitCodeProcess(running[slot], &exitCode);
+        CloseHandle(running[slot]);
+        running[slot] = running[runningCount - 1];
+        runningPoints[slot] = runningPoints[runningCount - 1];
+        runningCount--;
+        finished++;
+
+        point->completed = exitCode == 0 && LoadResults(point->resultPath, &point->result);
+        DeleteFileA(point->scenarioPath);
+        DeleteFileA(point->resultPath);
+
+        if (point->completed) {
+            printf("[%lu/%lu] rate %.2f req/s, %lu channels, buffer %lu: throughput %.2f/s, "
+                "drop %.2f%%, utilization %.0f%%, p99 %.2f ms\n",
+                finished, pointCount, point->arrivalRate, point->channelsPerStage,
+                point->bufferSize, point->result.throughput, point->result.dropRate * 100,
+                point->result.utilization * 100, point->result.p99Latency);
+        } else {
+            printf("[%lu/%lu] rate %.2f req/s, %lu channels, buffer %lu: failed\n",
+                finished, pointCount, point->arrivalRate, point->channelsPerStage,
+                point->bufferSize);
+        }
+    }
+
+    WriteSweepCsv(csvPath, points, pointCount, targetDropRate);
+    WriteSweepJson(jsonPath, points, pointCount, targetDropRate);
+    PrintCapacityPlan(points, pointCount, targetDropRate);
+    printf("\nResults written to %s and %s\n", csvPath, jsonPath);
+
+    CloseHandle(nullOutput);
+    HeapFree(GetProcessHeap(), 0, points);
+    HeapFree(GetProcessHeap(), 0, running);
+    HeapFree(GetProcessHeap(), 0, runningPoints);
+    FreeParameters(&base);
+    return 0;
+}
+
+// Использование:
+//   QueueSystem [дисциплина ступени 1] [дисциплина ступени 2] ...
+//   QueueSystem --scenario <файл.ini> [--result <файл результатов>]
+//   QueueSystem --sweep <файл.ini>
+// Дисциплины: FIFO, SJF, EDF, PRIORITY
+int main(int argc, char* argv[]) {
+    char scenarioPath[MAX_PATH] = "";
+    char resultPath[MAX_PATH] = "";
+    ScenarioResult result = {0};
+    
+    // Пути передаются в GetPrivateProfileString* полностью, иначе файл
+    // ищется в каталоге Windows
+    if (argc >= 3 && strcmp(argv[1], "--sweep") == 0) {
+        GetFullPathNameA(argv[2], MAX_PATH, scenarioPath, NULL);
+        return RunSweep(scenarioPath);
+    }
+    
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--scenario") == 0) {
+            GetFullPathNameA(argv[++i], MAX_PATH, scenarioPath, NULL);
+        } else if (strcmp(argv[i], "--result") == 0) {
+            GetFullPathNameA(argv[++i], MAX_PATH, resultPath, NULL);
+        }
+    }
+    
+    // Инициализация параметров системы
+    if (scenarioPath[0]) {
+        if (!LoadScenario(scenarioPath, &globalParams)) {
+            return 1;
+        }
+    } else {
+        SetDefaultParameters(&globalParams, 3);
+        for (DWORD i = 0; i < globalParams.stageCount && (int)i + 1 < argc; i++) {
+            if (!ParseDiscipline(argv[i + 1], &globalParams.disciplines[i])) {
+                printf("Unknown discipline: %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+    }
+    
+    if (!LoadWorkload()) {
+        FreeParameters(&globalParams);
+        return 1;
+    }
+    
+    RunSimulation(&result);
+    FreeWorkload();
+    
+    if (resultPath[0]) {
+        DeleteFileA(resultPath);
+        if (!SaveResults(resultPath, &result)) {
+            FreeParameters(&globalParams);
+            return 1;
+        }
+    }
     
+    FreeParameters(&globalParams);
     return 0;
 }
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <windows.h>
+
+#define PRIORITY_CLASS_COUNT 3          // Классы приоритета, 0 - наивысший
+#define MAX_ARRIVAL_RATE 1000000.0     // Заявок в секунду на генератор: интервал не короче 1 мкс
+
+// Гистограмма задержек: первые 16 корзин по 1 мкс, далее по 16 корзин
+// на каждую степень двойки (относительная погрешность не более 1/32)
+#define LATENCY_SUB_BUCKETS 16
+#define LATENCY_BUCKET_COUNT (LATENCY_SUB_BUCKETS * 61)
+
+// Дисциплина обслуживания буфера ступени
+typedef enum {
+    DISCIPLINE_FIFO,        // В порядке поступления
+    DISCIPLINE_SJF,         // Кратчайшая заявка первой (по processingTime)
+    DISCIPLINE_EDF,         // Ближайший срок первым (по deadline)
+    DISCIPLINE_PRIORITY     // Классы приоритета со старением
+} QueueDiscipline;
+
+// Процесс поступления заявок
+typedef enum {
+    ARRIVAL_FIXED,          // Равные интервалы
+    ARRIVAL_POISSON,        // Пуассоновский поток
+    ARRIVAL_MMPP,           // Марковски модулированный пуассоновский поток (пачки)
+    ARRIVAL_TRACE           // Воспроизведение трассы из файла
+} ArrivalProcess;
+
+// Распределение времени обработки
+typedef enum {
+    SERVICE_UNIFORM,        // Равномерное на [minProcessingTime, maxProcessingTime]
+    SERVICE_EXPONENTIAL,    // Экспоненциальное со средним meanProcessingTime
+    SERVICE_LOGNORMAL,      // Логнормальное со средним meanProcessingTime
+    SERVICE_EMPIRICAL       // Выборка из файла
+} ServiceDistribution;
+
+// Запись трассы поступлений
+typedef struct {
+    double offset;              // мс от начала симуляции
+    DWORD processingTime;       // мс; 0 - по распределению обработки
+} TraceEntry;
+
+// Заявка
+typedef struct {
+    DWORD id;
+    DWORD creationTime;
+    DWORD processingTime;
+    DWORD priorityClass;
+    ULONGLONG arrivalTime;      // мкс, вход в систему
+    ULONGLONG deadline;         // мкс, абсолютный срок завершения
+    ULONGLONG enqueueTime;      // мкс, постановка в буфер текущей ступени
+    ULONGLONG sequence;         // порядковый номер в буфере текущей ступени
+} Request;
+
+// Буфер ступени, защищённый критической секцией.
+// Ожидание реализовано на условных переменных, поэтому простаивающие
+// каналы спят в ядре и просыпаются сразу после постановки заявки.
+// SJF и EDF хранят заявки в двоичной куче, FIFO и PRIORITY - в кольцевых
+// очередях по классам (для FIFO класс один).
+// Каналы с номером не меньше activeChannels выведены контроллером
+// масштабирования из работы и спят на parked.
+typedef struct {
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE notEmpty;
+    CONDITION_VARIABLE parked;
+    DWORD activeChannels;
+    DWORD waitingChannels;      // активные каналы, ожидающие на notEmpty
+    QueueDiscipline discipline;
+    Request** heap;
+    Request** classBuffers[PRIORITY_CLASS_COUNT];
+    DWORD classHead[PRIORITY_CLASS_COUNT];
+    DWORD classCount[PRIORITY_CLASS_COUNT];
+    DWORD classes;
+    ULONGLONG agingInterval;    // мкс ожидания, повышающие приоритет на класс
+    ULONGLONG nextSequence;
+    DWORD capacity;
+    DWORD count;
+} StageQueue;
+
+// Гистограмма времени пребывания
+typedef struct {
+    ULONGLONG count;
+    ULONGLONG sum;              // мкс
+    ULONGLONG max;              // мкс
+    DWORD buckets[LATENCY_BUCKET_COUNT];
+} LatencyHistogram;
+
+// Статистика канала
+typedef struct {
+    DWORD processedRequests;
+    DWORD totalProcessingTime;
+    DWORD stolenRequests;          // заявки, взятые из буферов других ступеней
+    DWORD stolenProcessingTime;    // мс обработки украденных заявок
+    ULONGLONG idleTime;            // мкс, по монотонным часам
+    volatile LONG inFlight;        // 1, пока канал обрабатывает заявку
+    LatencyHistogram sojourn;      // пребывание обработанных каналом заявок на их ступени
+} ChannelStats;
+
+// Статистика ступени
+typedef struct {
+    DWORD totalRequests;
+    DWORD droppedRequests;
+    volatile LONG inFlight;     // заявки в обработке, меняется через Interlocked*
+    DWORD busyTime;             // мс обработки заявок из буфера ступени, в том числе украденных
+    DWORD missedDeadlines;
+    LatencyHistogram sojourn;   // от постановки в буфер до конца обработки
+    DWORD scaleUps;
+    DWORD scaleDowns;
+    double activeChannelTime;   // мс × активные каналы
+    ChannelStats* channelStats;
+} StageStats;
+
+// Решение контроллера масштабирования
+typedef struct {
+    DWORD time;                 // мс от начала симуляции
+    DWORD stageId;
+    DWORD fromChannels;
+    DWORD toChannels;
+    DWORD queueDepth;
+    double arrivalRate;         // заявок в секунду
+    double utilization;
+} ScalingEvent;
+
+// Параметры системы
+typedef struct {
+    DWORD stageCount;
+    DWORD* channelsPerStage;    // начальное число активных каналов
+    DWORD* minChannels;
+    DWORD* maxChannels;
+    DWORD channelBudget;        // предел суммы активных каналов всех ступеней
+    DWORD scalingInterval;      // мс
+    BOOL workStealing;
+    ArrivalProcess arrivalProcess;
+    double arrivalRate;         // заявок в секунду; 0 - 1000 / requestGenerationRate
+    double burstRate;           // MMPP: интенсивность внутри пачки
+    DWORD burstDuration;        // MMPP: средняя длительность пачки, мс
+    DWORD burstInterval;        // MMPP: среднее время между пачками, мс
+    DWORD generatorCount;
+    ULONGLONG seed;
+    ServiceDistribution serviceDistribution;
+    DWORD meanProcessingTime;   // мс
+    double processingTimeSigma; // логнормальное: σ логарифма
+    char traceFile[MAX_PATH];
+    char serviceSamplesFile[MAX_PATH];
+    DWORD metricsInterval;      // мс; 0 - без живых метрик
+    DWORD* bufferSizes;
+    DWORD requestGenerationRate;
+    DWORD minProcessingTime;
+    DWORD maxProcessingTime;
+    DWORD simulationTime;
+    QueueDiscipline* disciplines;
+    DWORD minDeadline;          // мс, относительный срок заявки
+    DWORD maxDeadline;
+    DWORD agingInterval;        // мс
+} SystemParameters;
+
+// Параметры потока-генератора. Каждый генератор выдаёт свою долю потока
+// со своим независимым отрезком последовательности xoshiro256**.
+typedef struct {
+    DWORD generatorId;
+    ULONGLONG random[4];
+    StageQueue* queue;
+    StageStats* stats;
+    ULONGLONG startTime;        // мкс, общее для всех генераторов начало расписания
+    DWORD burstState;           // MMPP: номер текущего состояния в burstSchedule
+    DWORD traceIndex;
+    DWORD emittedRequests;
+    ULONGLONG totalLag;         // мкс опоздания выдачи относительно расписания
+    ULONGLONG maxLag;
+} GeneratorParams;
+
+// Параметры потока канала
+typedef struct {
+    DWORD stageId;
+    DWORD channelId;
+    StageQueue* queue;
+    StageStats* stats;
+    SystemParameters* params;
+    volatile BOOL* isRunning;
+} ChannelParams;
+
+// Живые метрики публикуются в именованной разделяемой памяти
+// (METRICS_MAPPING_NAME с PID процесса) и читаются QueueMonitor.
+// Запись защищена seqlock: sequence нечётно, пока идёт запись; читатель
+// копирует снимок и повторяет, если sequence изменилось.
+#define METRICS_MAPPING_NAME "Local\\QueueSystemMetrics_%lu"
+#define METRICS_MAX_STAGES 8
+#define METRICS_MAX_CHANNELS 16
+#define METRICS_OVERHEAD_BUDGET 0.01
+
+typedef struct {
+    DWORD processedRequests;
+    BOOL active;
+    DWORD inFlight;             // 1, если канал обрабатывает заявку
+    double throughput;          // завершений в секунду за последний период
+    double utilization;         // доля последнего периода, занятая заявками своей ступени
+    double stolenUtilization;   // то же для украденных заявок
+    double meanLatency;         // мс, время пребывания обработанных каналом заявок за период
+    double p50Latency;
+    double p95Latency;
+    double p99Latency;
+} ChannelMetrics;
+
+typedef struct {
+    DWORD queueDepth;
+    DWORD activeChannels;
+    DWORD inFlight;
+    DWORD totalRequests;
+    DWORD droppedRequests;
+    DWORD completedRequests;
+    double throughput;          // завершений в секунду за последний период
+    double utilization;         // занятость активных каналов заявками ступени
+    double meanLatency;         // мс, время пребывания за последний период
+    double p50Latency;
+    double p95Latency;
+    double p99Latency;
+    DWORD channelCount;
+    ChannelMetrics channels[METRICS_MAX_CHANNELS];
+} StageMetrics;
+
+typedef struct {
+    volatile LONG sequence;
+    BOOL running;
+    DWORD stageCount;
+    DWORD sampleInterval;       // мс, текущий период сэмплера
+    ULONGLONG sampleCount;
+    double elapsedTime;         // мс от начала симуляции
+    double samplerOverhead;     // доля одного ядра, занятая сэмплером
+    StageMetrics stages[METRICS_MAX_STAGES];
+} MetricsSnapshot;
+
+// Итоги прогона сценария
+typedef struct {
+    DWORD generated;
+    DWORD completed;
+    DWORD dropped;
+    double throughput;          // завершённых заявок в секунду
+    double dropRate;
+    double utilization;         // доля времени активных каналов, занятая обработкой
+    double meanLatency;         // мс, от поступления до выхода из системы
+    double p50Latency;
+    double p95Latency;
+    double p99Latency;
+} ScenarioResult;
+
+// Точка перебора параметров
+typedef struct {
+    double arrivalRate;         // заявок в секунду
+    DWORD requestGenerationRate;// мс между заявками, для совместимости; 0 - меньше 1 мс
+    DWORD channelsPerStage;
+    DWORD bufferSize;
+    char scenarioPath[MAX_PATH];
+    char resultPath[MAX_PATH];
+    BOOL completed;
+    ScenarioResult result;
+} SweepPoint;